@@ -0,0 +1,72 @@
+/*
+ Microphone array geometry
+
+ Authors:
+ Luca Bondi (luca.bondi@polimi.it)
+*/
+
+#include "ArrayGeometry.h"
+
+ArrayGeometry ArrayGeometry::fromArrayLayout(const ArrayLayout &layout, float micDistX, float micDistY) {
+    const int numMic = ::getNumMics(layout);
+    const int numRows = getNumRows(layout);
+    const int numMicPerRow = numMic / numRows;
+    ArrayGeometry geometry;
+    geometry.positions = Mtx::Zero(numMic, 3);
+    for (auto micIdx = 0; micIdx < numMic; micIdx++) {
+        geometry.positions(micIdx, 0) = (micIdx % numMicPerRow) * micDistX;
+        geometry.positions(micIdx, 1) = (micIdx / numMicPerRow) * micDistY;
+    }
+    return geometry;
+}
+
+String ArrayGeometry::loadFromFile(const File &file) {
+    if (!file.existsAsFile()) {
+        return "cannot open " + file.getFullPathName();
+    }
+    StringArray lines;
+    file.readLines(lines);
+    std::vector<std::array<float, 3>> micPositions;
+    for (auto lineIdx = 0; lineIdx < lines.size(); lineIdx++) {
+        const String line = lines[lineIdx].trim();
+        if (line.isEmpty() || line.startsWithChar('#'))
+            continue;
+        const auto tokens = StringArray::fromTokens(line, ",", "");
+        if (tokens.size() != 3) {
+            return file.getFileName() + ":" + String(lineIdx + 1) + ": expected x, y, z";
+        }
+        micPositions.push_back({tokens[0].trim().getFloatValue(), tokens[1].trim().getFloatValue(),
+                                tokens[2].trim().getFloatValue()});
+    }
+    if (micPositions.empty()) {
+        return file.getFileName() + ": no microphones";
+    }
+    positions.resize((int) micPositions.size(), 3);
+    for (auto micIdx = 0; micIdx < (int) micPositions.size(); micIdx++) {
+        for (auto axis = 0; axis < 3; axis++) {
+            positions(micIdx, axis) = micPositions[micIdx][axis];
+        }
+    }
+    return {};
+}
+
+int ArrayGeometry::getNumMics() const {
+    return (int) positions.rows();
+}
+
+const Mtx &ArrayGeometry::getPositions() const {
+    return positions;
+}
+
+Vec ArrayGeometry::getCenter() const {
+    return (positions.colwise().minCoeff() + positions.colwise().maxCoeff()).transpose() / 2;
+}
+
+float ArrayGeometry::getAperture() const {
+    float aperture = 0;
+    for (auto micIdx = 0; micIdx < positions.rows(); micIdx++) {
+        const float maxDist = (positions.rowwise() - positions.row(micIdx)).rowwise().norm().maxCoeff();
+        aperture = jmax(aperture, maxDist);
+    }
+    return aperture;
+}
@@ -0,0 +1,51 @@
+/*
+ Microphone array geometry
+
+ Authors:
+ Luca Bondi (luca.bondi@polimi.it)
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "ebeamerDefs.h"
+#include "SignalProcessing.h"
+
+/** Positions of the microphones of an array [m]
+
+ Same convention as BeamParameters, with the array seen from behind:
+ x grows towards the last microphone of an eStick (right), y grows downwards (bottom),
+ z grows from the array towards the sources (front).
+ */
+class ArrayGeometry {
+
+public:
+
+    ArrayGeometry() = default;
+
+    /** Regular grid of a layout of eSticks, all microphones on the z = 0 plane */
+    static ArrayGeometry fromArrayLayout(const ArrayLayout &layout, float micDistX, float micDistY);
+
+    /** Load the positions from a text file
+
+     One microphone per line, in channel order, as "x, y, z" in meters. Empty lines and lines starting with # are skipped.
+     @return: error message, empty on success
+     */
+    String loadFromFile(const File &file);
+
+    /** Number of microphones */
+    int getNumMics() const;
+
+    /** Positions, a row per microphone with x, y, z columns [m] */
+    const Mtx &getPositions() const;
+
+    /** Center of the bounding box of the array [m] */
+    Vec getCenter() const;
+
+    /** Largest distance between two microphones [m] */
+    float getAperture() const;
+
+private:
+
+    Mtx positions;
+};
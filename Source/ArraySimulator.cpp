@@ -0,0 +1,178 @@
+/*
+ Plane-wave array signal simulator
+ 
+ Authors:
+ Luca Bondi (luca.bondi@polimi.it)
+*/
+
+#include "ArraySimulator.h"
+
+ArraySimulator::ArraySimulator(const ArrayLayout &layout, double sampleRate_, int maximumBlockSize_, int64 seed) : rng(seed) {
+    
+    numMic = getNumMics(layout);
+    sampleRate = sampleRate_;
+    maximumBlockSize = maximumBlockSize_;
+    
+    /** Same geometry as the Beamformer */
+    const float micDistX = 0.03;
+    const float micDistY = 0.03;
+    alg = std::make_unique<DAS::FarfieldURA>(micDistX, micDistY, numMic, getNumRows(layout), sampleRate, soundspeed);
+    
+    fft = std::make_shared<dsp::FFT>(roundToInt(std::ceil(std::log2(alg->getFirLen() + maximumBlockSize - 1))));
+    
+    sourceHistory.setSize(maxNumSources, roundToInt(maxRt60 * sampleRate) + maximumBlockSize);
+    sourceHistory.clear();
+    
+    pathSignal.setSize(1, maximumBlockSize);
+    pathFFT = AudioBufferFFT(1, fft);
+    micSpectra = AudioBufferFFT(numMic, fft);
+    overlapBuffer.setSize(numMic, fft->getSize());
+    overlapBuffer.clear();
+}
+
+int ArraySimulator::getNumChannels() const {
+    return numMic;
+}
+
+void ArraySimulator::setNoiseLevel(float level) {
+    noiseGain = level <= -100 ? 0 : Decibels::decibelsToGain(level);
+}
+
+void ArraySimulator::setReverb(float rt60_, float directToReverbRatio_, int numReflections_) {
+    rt60 = jlimit(0.f, maxRt60, rt60_);
+    directToReverbRatio = directToReverbRatio_;
+    numReflections = jmax(0, numReflections_);
+}
+
+void ArraySimulator::addSource(const Source &source) {
+    
+    if ((int) sources.size() >= maxNumSources) {
+        jassertfalse;
+        return;
+    }
+    
+    const int sourceIdx = (int) sources.size();
+    sources.push_back(source);
+    sourcePhases.push_back(0);
+    
+    addPath(sourceIdx, source.doaX, source.doaY, 0, 1);
+    
+    if (rt60 > 0 && numReflections > 0) {
+        /** Reflections between 5 ms and rt60, decaying by 60 dB over rt60, normalized to the requested ratio */
+        const int minDelay = roundToInt(0.005 * sampleRate);
+        const int maxDelay = jmax(minDelay + 1, roundToInt(rt60 * sampleRate));
+        std::vector<int> delays(numReflections);
+        std::vector<float> gains(numReflections);
+        double tailEnergy = 0;
+        for (auto refIdx = 0; refIdx < numReflections; refIdx++) {
+            delays[refIdx] = minDelay + rng.nextInt(maxDelay - minDelay);
+            gains[refIdx] = std::pow(10.f, -3.f * delays[refIdx] / (rt60 * (float) sampleRate)) * (rng.nextBool() ? 1 : -1);
+            tailEnergy += gains[refIdx] * gains[refIdx];
+        }
+        const float tailGain = std::sqrt(Decibels::decibelsToGain(-directToReverbRatio) / tailEnergy);
+        for (auto refIdx = 0; refIdx < numReflections; refIdx++) {
+            addPath(sourceIdx, 2 * rng.nextFloat() - 1, 2 * rng.nextFloat() - 1, delays[refIdx],
+                    gains[refIdx] * tailGain);
+        }
+    }
+}
+
+void ArraySimulator::addPath(int sourceIdx, float doaX, float doaY, int delay, float gain) {
+    
+    /** The Beamformer compensates the propagation delays of a direction, the opposite direction reproduces them */
+    AudioBuffer<float> fir(numMic, alg->getFirLen());
+    alg->getFir(fir, {-doaX, -doaY, 0});
+    
+    /** Unit gain at each microphone */
+    float dcGain = 0;
+    for (auto smpIdx = 0; smpIdx < fir.getNumSamples(); smpIdx++) {
+        dcGain += fir.getSample(0, smpIdx);
+    }
+    if (dcGain != 0) {
+        fir.applyGain(1 / dcGain);
+    }
+    
+    Path path{sourceIdx, delay, gain, AudioBufferFFT(numMic, fft)};
+    path.firFFT.setTimeSeries(fir);
+    path.firFFT.prepareForConvolution();
+    paths.push_back(std::move(path));
+}
+
+void ArraySimulator::generateSource(int sourceIdx, int numSamples) {
+    
+    const Source &source = sources[sourceIdx];
+    const float gain = Decibels::decibelsToGain(source.level);
+    const int historyLen = sourceHistory.getNumSamples();
+    float *history = sourceHistory.getWritePointer(sourceIdx);
+    
+    for (auto smpIdx = 0; smpIdx < numSamples; smpIdx++) {
+        float sample;
+        if (source.toneFreq > 0) {
+            sample = MathConstants<float>::sqrt2 * std::sin(sourcePhases[sourceIdx]);
+            sourcePhases[sourceIdx] = std::fmod(sourcePhases[sourceIdx] + MathConstants<double>::twoPi * source.toneFreq / sampleRate,
+                                                MathConstants<double>::twoPi);
+        } else {
+            /** Uniform white noise with unit variance */
+            sample = std::sqrt(3.f) * (2 * rng.nextFloat() - 1);
+        }
+        history[(historyWriteIdx + smpIdx) % historyLen] = gain * sample;
+    }
+}
+
+void ArraySimulator::processBlock(AudioBuffer<float> &out) {
+    
+    const int numSamples = out.getNumSamples();
+    jassert(numSamples <= maximumBlockSize);
+    jassert(out.getNumChannels() >= numMic);
+    
+    const int historyLen = sourceHistory.getNumSamples();
+    for (auto sourceIdx = 0; sourceIdx < (int) sources.size(); sourceIdx++) {
+        generateSource(sourceIdx, numSamples);
+    }
+    
+    /** Sum all the paths in frequency domain, then a single inverse FFT per microphone */
+    micSpectra.reset();
+    for (auto pathIdx = 0; pathIdx < (int) paths.size(); pathIdx++) {
+        Path &path = paths[pathIdx];
+        const float *history = sourceHistory.getReadPointer(path.sourceIdx);
+        float *signal = pathSignal.getWritePointer(0);
+        const int readIdx = historyWriteIdx - path.delay + historyLen;
+        for (auto smpIdx = 0; smpIdx < numSamples; smpIdx++) {
+            signal[smpIdx] = path.gain * history[(readIdx + smpIdx) % historyLen];
+        }
+        pathSignal.clear(0, numSamples, pathSignal.getNumSamples() - numSamples);
+        
+        pathFFT.setTimeSeries(pathSignal);
+        pathFFT.prepareForConvolution();
+        for (auto micIdx = 0; micIdx < numMic; micIdx++) {
+            if (pathIdx == 0) {
+                micSpectra.convolve(micIdx, pathFFT, 0, path.firFFT, micIdx);
+            } else {
+                micSpectra.addConvolution(micIdx, pathFFT, 0, path.firFFT, micIdx);
+            }
+        }
+    }
+    historyWriteIdx = (historyWriteIdx + numSamples) % historyLen;
+    
+    /** Overlap and add, then shift */
+    if (!paths.empty()) {
+        micSpectra.addToTimeSeries(overlapBuffer);
+    }
+    for (auto micIdx = 0; micIdx < numMic; micIdx++) {
+        out.copyFrom(micIdx, 0, overlapBuffer, micIdx, 0, numSamples);
+        const int numShift = overlapBuffer.getNumSamples() - numSamples;
+        FloatVectorOperations::copy(overlapBuffer.getWritePointer(micIdx),
+                                    overlapBuffer.getReadPointer(micIdx) + numSamples, numShift);
+        overlapBuffer.clear(micIdx, numShift, numSamples);
+        
+        if (noiseGain > 0) {
+            float *data = out.getWritePointer(micIdx);
+            for (auto smpIdx = 0; smpIdx < numSamples; smpIdx++) {
+                data[smpIdx] += noiseGain * std::sqrt(3.f) * (2 * rng.nextFloat() - 1);
+            }
+        }
+    }
+    for (auto chIdx = numMic; chIdx < out.getNumChannels(); chIdx++) {
+        out.clear(chIdx, 0, numSamples);
+    }
+}
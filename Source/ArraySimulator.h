@@ -0,0 +1,129 @@
+/*
+ Plane-wave array signal simulator
+ 
+ Authors:
+ Luca Bondi (luca.bondi@polimi.it)
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "ebeamerDefs.h"
+#include "AudioBufferFFT.h"
+#include "BeamformingAlgorithms.h"
+
+/** Synthesize the signals captured by an eStick array from far-field sources
+ 
+ The geometry is the same as DAS::FarfieldURA, hence a source at (doaX, doaY) is in the direction the Beamformer
+ steers to with the same BeamParameters. Each source can be followed by a reverberation tail, made of reflections
+ arriving from random directions with exponentially decaying gains. Uncorrelated sensor noise is added on top.
+ The output is deterministic given the seed.
+ */
+class ArraySimulator {
+    
+public:
+    
+    /** A far-field source */
+    typedef struct {
+        /** Direction of arrival, same convention as BeamParameters */
+        float doaX;
+        float doaY;
+        /** RMS level at each microphone [dBFS] */
+        float level;
+        /** Frequency of a sinusoidal source [Hz]. 0 for white noise. */
+        float toneFreq;
+    } Source;
+    
+    /** Initialize the simulator
+     
+     @param layout: eSticks layout
+     @param sampleRate: sampling frequency [Hz]
+     @param maximumBlockSize: maximum number of samples per processBlock
+     @param seed: seed of the random generators
+     */
+    ArraySimulator(const ArrayLayout &layout, double sampleRate, int maximumBlockSize, int64 seed = 1);
+    
+    /** Add a source. Sources can be added at any time. */
+    void addSource(const Source &source);
+    
+    /** Set the level of the uncorrelated sensor noise [dBFS]. -100 or below for no noise. */
+    void setNoiseLevel(float level);
+    
+    /** Set the reverberation tail added to the sources added from now on
+     
+     @param rt60: time for the reflections to decay by 60 dB [s]. 0 for no reverberation.
+     @param directToReverbRatio: energy of the direct path over the energy of the tail [dB]
+     @param numReflections: number of reflections per source
+     */
+    void setReverb(float rt60, float directToReverbRatio, int numReflections = 32);
+    
+    /** Number of output channels */
+    int getNumChannels() const;
+    
+    /** Render the next block of samples
+     
+     @param out: buffer with numChannels >= getNumChannels() and numSamples <= maximumBlockSize
+     */
+    void processBlock(AudioBuffer<float> &out);
+    
+private:
+    
+    /** A propagation path from a source to the array */
+    typedef struct {
+        int sourceIdx;
+        /** Delay with respect to the direct path [samples] */
+        int delay;
+        float gain;
+        /** Steering filters, one channel per microphone */
+        AudioBufferFFT firFFT;
+    } Path;
+    
+    /** Add a path for a source from a given direction */
+    void addPath(int sourceIdx, float doaX, float doaY, int delay, float gain);
+    
+    /** Generate the next samples of a source into its history */
+    void generateSource(int sourceIdx, int numSamples);
+    
+    const float soundspeed = 343;
+    
+    int numMic;
+    double sampleRate;
+    int maximumBlockSize;
+    Random rng;
+    
+    /** Used to compute the propagation filters */
+    std::unique_ptr<DAS::FarfieldURA> alg;
+    
+    std::shared_ptr<dsp::FFT> fft;
+    
+    std::vector<Source> sources;
+    
+    /** Samples of each source, circular, long enough for the longest reflection delay */
+    AudioBuffer<float> sourceHistory;
+    int historyWriteIdx = 0;
+    
+    /** Phase of sinusoidal sources [rad] */
+    std::vector<double> sourcePhases;
+    
+    std::vector<Path> paths;
+    
+    float noiseGain = 0;
+    
+    float rt60 = 0;
+    float directToReverbRatio = 10;
+    int numReflections = 0;
+    
+    /** Maximum sources and reflection delay, sizing the history */
+    const int maxNumSources = 16;
+    const float maxRt60 = 2;
+    
+    /** Scratch buffers */
+    AudioBuffer<float> pathSignal;
+    AudioBufferFFT pathFFT;
+    AudioBufferFFT micSpectra;
+    
+    /** Overlap-add accumulator, one channel per microphone */
+    AudioBuffer<float> overlapBuffer;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ArraySimulator)
+};
@@ -157,3 +157,14 @@ void AudioBufferFFT::convolve(int outputChannel, const AudioBufferFFT &in_, int
 
     readyForConvolution = true;
 }
+
+void AudioBufferFFT::addConvolution(int outputChannel, const AudioBufferFFT &in_, int inChannel,
+                                    const AudioBufferFFT &filter_, int filterChannel) {
+
+    jassert(in_.isReadyForConvolution());
+    jassert(filter_.isReadyForConvolution());
+    jassert(readyForConvolution);
+
+    convolutionProcessingAndAccumulate(in_.getReadPointer(inChannel), filter_.getReadPointer(filterChannel),
+                                       getWritePointer(outputChannel), fft->getSize());
+}
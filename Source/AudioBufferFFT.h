@@ -33,6 +33,11 @@ public:
     void
     convolve(int outputChannel, const AudioBufferFFT &in_, int inChannel, AudioBufferFFT &filter_, int filterChannel);
 
+    /** Same as convolve, but accumulates the result on the output channel instead of overwriting it */
+    void
+    addConvolution(int outputChannel, const AudioBufferFFT &in_, int inChannel, const AudioBufferFFT &filter_,
+                   int filterChannel);
+
     void prepareForConvolution();
 
     bool isReadyForConvolution() const { return readyForConvolution; };
@@ -0,0 +1,75 @@
+/*
+ Multichannel lock-free FIFO
+
+ Authors:
+ Luca Bondi (luca.bondi@polimi.it)
+*/
+
+#include "AudioBufferFifo.h"
+
+AudioBufferFifo::AudioBufferFifo(int numChannels, int capacity) : fifo(capacity + 1) {
+    /** AbstractFifo keeps one slot empty to distinguish full from empty */
+    buffer.setSize(numChannels, capacity + 1);
+    buffer.clear();
+}
+
+int AudioBufferFifo::push(const AudioBuffer<float> &src, int startSample, int numSamples) {
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite(numSamples, start1, size1, start2, size2);
+
+    const int numChannelsToCopy = jmin(buffer.getNumChannels(), src.getNumChannels());
+    for (auto chIdx = 0; chIdx < numChannelsToCopy; chIdx++) {
+        if (size1 > 0)
+            buffer.copyFrom(chIdx, start1, src, chIdx, startSample, size1);
+        if (size2 > 0)
+            buffer.copyFrom(chIdx, start2, src, chIdx, startSample + size1, size2);
+    }
+    for (auto chIdx = numChannelsToCopy; chIdx < buffer.getNumChannels(); chIdx++) {
+        if (size1 > 0)
+            buffer.clear(chIdx, start1, size1);
+        if (size2 > 0)
+            buffer.clear(chIdx, start2, size2);
+    }
+
+    fifo.finishedWrite(size1 + size2);
+    return size1 + size2;
+}
+
+int AudioBufferFifo::pop(AudioBuffer<float> &dst, int startSample, int numSamples) {
+    int start1, size1, start2, size2;
+    fifo.prepareToRead(numSamples, start1, size1, start2, size2);
+
+    const int numChannelsToCopy = jmin(buffer.getNumChannels(), dst.getNumChannels());
+    for (auto chIdx = 0; chIdx < numChannelsToCopy; chIdx++) {
+        if (size1 > 0)
+            dst.copyFrom(chIdx, startSample, buffer, chIdx, start1, size1);
+        if (size2 > 0)
+            dst.copyFrom(chIdx, startSample + size1, buffer, chIdx, start2, size2);
+    }
+
+    fifo.finishedRead(size1 + size2);
+    return size1 + size2;
+}
+
+int AudioBufferFifo::discard(int numSamples) {
+    const int numToDiscard = jmin(numSamples, fifo.getNumReady());
+    fifo.finishedRead(numToDiscard);
+    return numToDiscard;
+}
+
+int AudioBufferFifo::getNumReady() const {
+    return fifo.getNumReady();
+}
+
+int AudioBufferFifo::getFreeSpace() const {
+    return fifo.getFreeSpace();
+}
+
+int AudioBufferFifo::getNumChannels() const {
+    return buffer.getNumChannels();
+}
+
+void AudioBufferFifo::reset() {
+    fifo.reset();
+    buffer.clear();
+}
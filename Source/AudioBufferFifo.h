@@ -0,0 +1,68 @@
+/*
+ Multichannel lock-free FIFO
+
+ Authors:
+ Luca Bondi (luca.bondi@polimi.it)
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+/** Wait-free single-producer/single-consumer FIFO of multichannel audio samples.
+
+ The producer (e.g. the audio thread) calls push, the consumer (e.g. the DOA thread) calls pop.
+ All the memory is allocated at construction time, no locks are taken on either side.
+ */
+class AudioBufferFifo {
+
+public:
+
+    /** Allocate the FIFO
+
+     @param numChannels: number of channels
+     @param capacity: maximum number of samples per channel that can be stored
+     */
+    AudioBufferFifo(int numChannels, int capacity);
+
+    /** Push samples into the FIFO. Producer side only.
+
+     Channels in excess are ignored, missing channels are filled with zeros.
+     @return: number of samples actually written. Less than numSamples if the FIFO is full.
+     */
+    int push(const AudioBuffer<float> &src, int startSample, int numSamples);
+
+    /** Pop samples from the FIFO. Consumer side only.
+
+     @return: number of samples actually read. Less than numSamples if not enough samples are available.
+     */
+    int pop(AudioBuffer<float> &dst, int startSample, int numSamples);
+
+    /** Discard samples from the FIFO. Consumer side only.
+
+     @return: number of samples actually discarded.
+     */
+    int discard(int numSamples);
+
+    /** Number of samples ready to be read */
+    int getNumReady() const;
+
+    /** Number of samples that can be written */
+    int getFreeSpace() const;
+
+    /** Number of channels */
+    int getNumChannels() const;
+
+    /** Clear the FIFO. Not thread safe. */
+    void reset();
+
+private:
+
+    /** Read and write indexes */
+    AbstractFifo fifo;
+
+    /** Samples storage */
+    AudioBuffer<float> buffer;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AudioBufferFifo)
+};
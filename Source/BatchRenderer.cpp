@@ -0,0 +1,434 @@
+/*
+ Offline batch renderer
+ 
+ Authors:
+ Luca Bondi (luca.bondi@polimi.it)
+*/
+
+#include "BatchRenderer.h"
+#include <iostream>
+#include <deque>
+#include <map>
+#include <tuple>
+
+BatchRenderer::BatchRenderer(const ArgumentList &args) {
+    
+    formatManager.registerBasicFormats();
+    
+    for (const auto &token : StringArray::fromTokens(args.getValueForOption("--render"), ",", "\"")) {
+        const File f = File::getCurrentWorkingDirectory().getChildFile(token.trim().unquoted());
+        if (f.isDirectory()) {
+            auto children = f.findChildFiles(File::findFiles, false, formatManager.getWildcardForAllFormats());
+            children.sort();
+            inputFiles.addArray(children);
+        } else {
+            inputFiles.add(f);
+        }
+    }
+    
+    if (args.containsOption("--beams")) {
+        beamParams.clear();
+        for (const auto &beam : StringArray::fromTokens(args.getValueForOption("--beams"), ";", "")) {
+            const auto values = StringArray::fromTokens(beam, ",", "");
+            if (values.size() >= 2) {
+                beamParams.push_back({jlimit(-1.f, 1.f, values[0].getFloatValue()),
+                                      jlimit(-1.f, 1.f, values[1].getFloatValue()),
+                                      values.size() > 2 ? jlimit(0.f, 1.f, values[2].getFloatValue()) : 0.2f,
+                                      values.size() > 3 ? jmax(0.f, values[3].getFloatValue()) : 0.f});
+            }
+        }
+    }
+    if (args.containsOption("--automation")) {
+        const File automationFile = args.getFileForOption("--automation");
+        if (!loadAutomation(automationFile)) {
+            std::cerr << "Cannot read automation " << automationFile.getFullPathName() << std::endl;
+        }
+    }
+    /** As many beams as the longest of the static parameters and the automation */
+    const size_t numBeams = jmax(beamParams.size(), automation.size());
+    beamParams.resize(numBeams, {0, 0, 0.2f});
+    automation.resize(numBeams);
+    
+    if (args.containsOption("--config"))
+        config = args.getValueForOption("--config");
+    if (args.containsOption("--geometry"))
+        geometryFile = args.getFileForOption("--geometry").getFullPathName();
+    if (args.containsOption("--nearfield"))
+        nearfieldMinDistance = jmax(0.f, args.getValueForOption("--nearfield").getFloatValue());
+    if (args.containsOption("--block-size"))
+        blockSize = jmax(16, args.getValueForOption("--block-size").getIntValue());
+    if (args.containsOption("--chunk-seconds"))
+        chunkSeconds = jlimit(1.0, 600.0, args.getValueForOption("--chunk-seconds").getDoubleValue());
+    if (args.containsOption("--threads"))
+        numThreads = args.getValueForOption("--threads").getIntValue();
+    if (numThreads <= 0)
+        numThreads = SystemStats::getNumCpus();
+    if (args.containsOption("--output-dir")) {
+        outputDir = args.getFileForOption("--output-dir");
+        outputDir.createDirectory();
+    }
+}
+
+bool BatchRenderer::loadAutomation(const File &file) {
+    
+    StringArray lines;
+    file.readLines(lines);
+    if (lines.isEmpty())
+        return false;
+    
+    for (const auto &line : lines) {
+        const auto values = StringArray::fromTokens(line, ",", "");
+        /** Skip headers, comments and malformed lines */
+        if (values.size() < 5 || !values[0].trim().containsOnly("0123456789"))
+            continue;
+        const int beamIdx = values[0].getIntValue() - 1;
+        if (beamIdx < 0)
+            continue;
+        if ((int) automation.size() <= beamIdx)
+            automation.resize(beamIdx + 1);
+        automation[beamIdx].push_back({values[1].getDoubleValue(),
+                                       {jlimit(-1.f, 1.f, values[2].getFloatValue()),
+                                        jlimit(-1.f, 1.f, values[3].getFloatValue()),
+                                        jlimit(0.f, 1.f, values[4].getFloatValue()),
+                                        values.size() > 5 ? jmax(0.f, values[5].getFloatValue()) : 0.f}});
+    }
+    for (auto &points : automation) {
+        std::stable_sort(points.begin(), points.end(), [](const AutomationPoint &a, const AutomationPoint &b) {
+            return a.time < b.time;
+        });
+    }
+    return true;
+}
+
+BeamParameters BatchRenderer::getBeamParameters(int beamIdx, double time) const {
+    
+    const auto &points = automation[beamIdx];
+    if (points.empty())
+        return beamParams[beamIdx];
+    if (time <= points.front().time)
+        return points.front().params;
+    if (time >= points.back().time)
+        return points.back().params;
+    
+    const auto next = std::upper_bound(points.begin(), points.end(), time, [](double t, const AutomationPoint &p) {
+        return t < p.time;
+    });
+    const auto prev = next - 1;
+    const float frac = (float) ((time - prev->time) / (next->time - prev->time));
+    return {prev->params.doaX + frac * (next->params.doaX - prev->params.doaX),
+            prev->params.doaY + frac * (next->params.doaY - prev->params.doaY),
+            prev->params.width + frac * (next->params.width - prev->params.width),
+            prev->params.distance + frac * (next->params.distance - prev->params.distance)};
+}
+
+std::shared_ptr<const BatchRenderer::FilterSchedule> BatchRenderer::createSchedule(int fileIdx) const {
+    
+    const int numBeams = (int) beamParams.size();
+    const double sampleRate = inputSampleRates[fileIdx];
+    const int numBlocks = (int) ((inputLengths[fileIdx] + blockSize - 1) / blockSize);
+    
+    /** Quantize the parameters of every block, assigning an index to each distinct state */
+    auto schedule = std::make_shared<FilterSchedule>();
+    std::map<std::tuple<int, int, int, int>, int> stateIdxs;
+    auto &states = schedule->states;
+    schedule->blockStates.resize(numBeams, std::vector<int>(numBlocks));
+    for (auto beamIdx = 0; beamIdx < numBeams; beamIdx++) {
+        for (auto blockIdx = 0; blockIdx < numBlocks; blockIdx++) {
+            const auto params = getBeamParameters(beamIdx, (double) blockIdx * blockSize / sampleRate);
+            const auto key = std::make_tuple(roundToInt(params.doaX / doaQuantization),
+                                             roundToInt(params.doaY / doaQuantization),
+                                             roundToInt(params.width / widthQuantization),
+                                             roundToInt((params.distance > 0 ? 1 / params.distance : 0) / invDistanceQuantization));
+            auto it = stateIdxs.find(key);
+            if (it == stateIdxs.end()) {
+                it = stateIdxs.emplace(key, (int) states.size()).first;
+                states.push_back({std::get<0>(key) * doaQuantization,
+                                  std::get<1>(key) * doaQuantization,
+                                  std::get<2>(key) * widthQuantization,
+                                  std::get<3>(key) > 0 ? 1 / (std::get<3>(key) * invDistanceQuantization) : 0.f});
+            }
+            schedule->blockStates[beamIdx][blockIdx] = it->second;
+        }
+    }
+    
+    std::cout << inputFiles[fileIdx].getFullPathName() << ": " << states.size() << " distinct beam states" << std::endl;
+    
+    return schedule;
+}
+
+int BatchRenderer::run() {
+    
+    if (inputFiles.isEmpty() || beamParams.empty()) {
+        std::cerr << "Nothing to render" << std::endl;
+        return 1;
+    }
+    
+    /** Read the properties of all the inputs before starting */
+    for (const auto &file : inputFiles) {
+        std::unique_ptr<AudioFormatReader> reader(formatManager.createReaderFor(file));
+        if (reader == nullptr) {
+            std::cerr << "Cannot read " << file.getFullPathName() << std::endl;
+            return 1;
+        }
+        ArrayLayout layout = getArrayLayout(ULA_1ESTICK);
+        if (config.isNotEmpty()) {
+            if (!parseArrayLayout(config, layout)) {
+                std::cerr << "Invalid config " << config << std::endl;
+                return 1;
+            }
+        } else {
+            /** The configuration with as many microphones as channels, the first if more than one,
+             otherwise a single row of eSticks
+             */
+            bool found = false;
+            for (auto configIdx = 0; configIdx < micConfigLabels.size() && !found; configIdx++) {
+                if (getNumMics(static_cast<MicConfig>(configIdx)) == (int) reader->numChannels) {
+                    layout = getArrayLayout(static_cast<MicConfig>(configIdx));
+                    found = true;
+                }
+            }
+            const ArrayLayout row = {(int) reader->numChannels / ESTICK_NUM_MICS, 1};
+            if (!found && reader->numChannels % ESTICK_NUM_MICS == 0 && isValidArrayLayout(row)) {
+                layout = row;
+            }
+        }
+        if (getNumMics(layout) > (int) reader->numChannels) {
+            std::cerr << file.getFullPathName() << ": " << (int) reader->numChannels << " channels, "
+                      << getArrayLayoutLabel(layout) << " needs " << getNumMics(layout) << std::endl;
+            return 1;
+        }
+        inputLengths.push_back(reader->lengthInSamples);
+        inputSampleRates.push_back(reader->sampleRate);
+        inputBitDepths.push_back(reader->usesFloatingPointData ? 32 : jlimit(16, 24, (int) reader->bitsPerSample));
+        inputLayouts.push_back(layout);
+    }
+    
+    /** Split the inputs in chunks */
+    std::vector<std::unique_ptr<Chunk>> chunks;
+    for (auto fileIdx = 0; fileIdx < inputFiles.size(); fileIdx++) {
+        const int64 chunkLen = jmax(1, roundToInt(chunkSeconds * inputSampleRates[fileIdx] / blockSize)) * (int64) blockSize;
+        for (int64 start = 0; start < inputLengths[fileIdx]; start += chunkLen) {
+            auto chunk = std::make_unique<Chunk>();
+            chunk->fileIdx = fileIdx;
+            chunk->start = start;
+            chunk->length = jmin(chunkLen, inputLengths[fileIdx] - start);
+            chunks.push_back(std::move(chunk));
+        }
+    }
+    
+    /** Render in parallel, write in order. A few chunks per thread are queued to bound the memory. */
+    ThreadPool workers(numThreads);
+    maxChunksInFlight = 2 * numThreads;
+    std::deque<Chunk *> inFlight;
+    size_t nextChunkIdx = 0;
+    int currentFileIdx = -1;
+    int scheduledFileIdx = -1;
+    std::shared_ptr<const FilterSchedule> schedule;
+    std::vector<std::unique_ptr<AudioFormatWriter>> writers;
+    const auto startTime = Time::getMillisecondCounterHiRes();
+    auto fileStartTime = startTime;
+    int exitCode = 0;
+    
+    while (nextChunkIdx < chunks.size() || !inFlight.empty()) {
+        
+        while (nextChunkIdx < chunks.size() && (int) inFlight.size() < maxChunksInFlight) {
+            Chunk *chunk = chunks[nextChunkIdx++].get();
+            if (chunk->fileIdx != scheduledFileIdx) {
+                scheduledFileIdx = chunk->fileIdx;
+                schedule = createSchedule(scheduledFileIdx);
+            }
+            chunk->schedule = schedule;
+            inFlight.push_back(chunk);
+            workers.addJob([this, chunk] {
+                renderChunk(*chunk);
+                chunk->done.signal();
+            });
+        }
+        
+        Chunk *chunk = inFlight.front();
+        inFlight.pop_front();
+        chunk->done.wait();
+        
+        if (chunk->fileIdx != currentFileIdx) {
+            currentFileIdx = chunk->fileIdx;
+            fileStartTime = Time::getMillisecondCounterHiRes();
+            if (!createWriters(currentFileIdx, writers)) {
+                exitCode = 1;
+            }
+        }
+        if (chunk->failed) {
+            std::cerr << "Cannot read " << inputFiles[chunk->fileIdx].getFullPathName() << " at sample "
+                      << chunk->start << std::endl;
+            exitCode = 1;
+        }
+        for (auto beamIdx = 0; beamIdx < (int) writers.size(); beamIdx++) {
+            if (writers[beamIdx] != nullptr) {
+                const float *beam = chunk->beams.getReadPointer(beamIdx);
+                writers[beamIdx]->writeFromFloatArrays(&beam, 1, (int) chunk->length);
+            }
+        }
+        chunk->beams.setSize(0, 0);
+        chunk->schedule = nullptr;
+        
+        if (chunk->start + chunk->length >= inputLengths[chunk->fileIdx]) {
+            /** Last chunk of the file, close the outputs */
+            writers.clear();
+            const double elapsed = (Time::getMillisecondCounterHiRes() - fileStartTime) / 1000;
+            std::cout << inputFiles[chunk->fileIdx].getFullPathName() << ": "
+                      << inputLengths[chunk->fileIdx] / inputSampleRates[chunk->fileIdx] << " s rendered in "
+                      << elapsed << " s" << std::endl;
+        }
+    }
+    
+    std::cout << "Total: " << (Time::getMillisecondCounterHiRes() - startTime) / 1000 << " s" << std::endl;
+    return exitCode;
+}
+
+void BatchRenderer::renderChunk(Chunk &chunk) {
+    
+    const File &file = inputFiles[chunk.fileIdx];
+    const ArrayLayout layout = inputLayouts[chunk.fileIdx];
+    const int numBeams = (int) beamParams.size();
+    
+    /** Chunks are already rendered in parallel, each on a single thread */
+    BeamformerSettings settings;
+    settings.doaEnabled = false;
+    settings.renderNumThreads = 1;
+    settings.geometryFile = geometryFile;
+    settings.nearfieldMinDistance = nearfieldMinDistance;
+    Beamformer beamformer(numBeams, layout, inputSampleRates[chunk.fileIdx], blockSize, settings);
+    std::vector<int> currentStates(numBeams, -1);
+    
+    /** Pre-roll of at least a FIR length fills the beamformer as the previous chunk would have done.
+     Whole blocks, so that filters switch at the same samples whatever the chunk.
+     */
+    const int64 preRollBlocks = (beamformer.getFirLen() + blockSize - 1) / blockSize;
+    const int64 preRoll = jmin(chunk.start, preRollBlocks * blockSize);
+    const int64 readStart = chunk.start - preRoll;
+    const int64 readEnd = chunk.start + chunk.length;
+    const int firstBlock = (int) (readStart / blockSize);
+    const int endBlock = (int) ((readEnd + blockSize - 1) / blockSize);
+    
+    /** Design the filters of the chunk, in order of first use, up to its share of the memory budget */
+    const auto &blockStates = chunk.schedule->blockStates;
+    std::vector<AudioBufferFFT> filters;
+    std::vector<int> filterStates;
+    std::vector<int> filterLastUse;
+    std::map<int, int> stateFilters;
+    int maxFilters = numBeams;
+    for (auto blockIdx = firstBlock; blockIdx < endBlock; blockIdx++) {
+        for (auto beamIdx = 0; beamIdx < numBeams; beamIdx++) {
+            const int stateIdx = blockStates[beamIdx][blockIdx];
+            if (stateFilters.count(stateIdx) > 0 || (int) filters.size() >= maxFilters)
+                continue;
+            stateFilters[stateIdx] = (int) filters.size();
+            filterStates.push_back(stateIdx);
+            filterLastUse.push_back(-1);
+            filters.emplace_back();
+            beamformer.getFirFFT(filters.back(), chunk.schedule->states[stateIdx]);
+            if (filters.size() == 1) {
+                const int64 filterBytes = (int64) sizeof(float) * filters[0].getNumChannels() * filters[0].getNumSamples();
+                maxFilters = jmax(numBeams, (int) (filterMemoryBudget / (maxChunksInFlight * filterBytes)));
+            }
+        }
+    }
+    
+    chunk.beams.setSize(numBeams, (int) chunk.length);
+    chunk.beams.clear();
+    
+    auto reader = createReader(file, {readStart, readEnd});
+    if (reader == nullptr) {
+        chunk.failed = true;
+        return;
+    }
+    
+    AudioBuffer<float> input((int) reader->numChannels, blockSize);
+    AudioBuffer<float> beams(numBeams, blockSize);
+    for (int64 pos = readStart; pos < readEnd; pos += blockSize) {
+        const int numSamples = (int) jmin((int64) blockSize, readEnd - pos);
+        input.setSize(input.getNumChannels(), numSamples, false, false, true);
+        beams.setSize(numBeams, numSamples, false, false, true);
+        if (!reader->read(&input, 0, numSamples, pos, true, true)) {
+            chunk.failed = true;
+            return;
+        }
+        const int blockIdx = (int) (pos / blockSize);
+        /** The filters of the beams that keep their state are in use, hence never the least recently used */
+        for (auto beamIdx = 0; beamIdx < numBeams; beamIdx++) {
+            const int stateIdx = blockStates[beamIdx][blockIdx];
+            if (stateIdx != currentStates[beamIdx])
+                continue;
+            const auto it = stateFilters.find(stateIdx);
+            if (it != stateFilters.end())
+                filterLastUse[it->second] = blockIdx;
+        }
+        for (auto beamIdx = 0; beamIdx < numBeams; beamIdx++) {
+            const int stateIdx = blockStates[beamIdx][blockIdx];
+            if (stateIdx == currentStates[beamIdx])
+                continue;
+            auto it = stateFilters.find(stateIdx);
+            if (it == stateFilters.end()) {
+                /** Over budget, replace the least recently used filter */
+                const int filterIdx = (int) (std::min_element(filterLastUse.begin(), filterLastUse.end()) - filterLastUse.begin());
+                stateFilters.erase(filterStates[filterIdx]);
+                beamformer.getFirFFT(filters[filterIdx], chunk.schedule->states[stateIdx]);
+                filterStates[filterIdx] = stateIdx;
+                it = stateFilters.emplace(stateIdx, filterIdx).first;
+            }
+            filterLastUse[it->second] = blockIdx;
+            beamformer.setBeamFir(beamIdx, filters[it->second]);
+            currentStates[beamIdx] = stateIdx;
+        }
+        beamformer.processBlock(input);
+        beamformer.getBeams(beams);
+        
+        /** Keep only the samples after the pre-roll */
+        const int64 outStart = jmax(pos, chunk.start);
+        const int skip = (int) (outStart - pos);
+        if (skip < numSamples) {
+            for (auto beamIdx = 0; beamIdx < numBeams; beamIdx++) {
+                chunk.beams.copyFrom(beamIdx, (int) (outStart - chunk.start), beams, beamIdx, skip, numSamples - skip);
+            }
+        }
+    }
+}
+
+std::unique_ptr<AudioFormatReader> BatchRenderer::createReader(const File &file, Range<int64> section) {
+    
+    if (auto *format = formatManager.findFormatForFileExtension(file.getFileExtension())) {
+        std::unique_ptr<MemoryMappedAudioFormatReader> mappedReader(format->createMemoryMappedReader(file));
+        if (mappedReader != nullptr && mappedReader->mapSectionOfFile(section)) {
+            return mappedReader;
+        }
+    }
+    /** Formats that cannot be mapped are streamed */
+    return std::unique_ptr<AudioFormatReader>(formatManager.createReaderFor(file));
+}
+
+bool BatchRenderer::createWriters(int fileIdx, std::vector<std::unique_ptr<AudioFormatWriter>> &writers) const {
+    
+    const File &input = inputFiles[fileIdx];
+    const File dir = outputDir != File() ? outputDir : input.getParentDirectory();
+    WavAudioFormat wav;
+    bool ok = true;
+    
+    writers.clear();
+    for (auto beamIdx = 0; beamIdx < (int) beamParams.size(); beamIdx++) {
+        const File output = dir.getChildFile(input.getFileNameWithoutExtension() + "-beam" + String(beamIdx + 1) + ".wav");
+        output.deleteFile();
+        std::unique_ptr<FileOutputStream> stream(output.createOutputStream());
+        AudioFormatWriter *writer = nullptr;
+        if (stream != nullptr) {
+            writer = wav.createWriterFor(stream.get(), inputSampleRates[fileIdx], 1, inputBitDepths[fileIdx], {}, 0);
+        }
+        if (writer != nullptr) {
+            /** The writer owns the stream */
+            stream.release();
+        } else {
+            std::cerr << "Cannot write " << output.getFullPathName() << std::endl;
+            ok = false;
+        }
+        writers.emplace_back(writer);
+    }
+    return ok;
+}
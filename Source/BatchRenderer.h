@@ -0,0 +1,146 @@
+/*
+ Offline batch renderer
+ 
+ Authors:
+ Luca Bondi (luca.bondi@polimi.it)
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "ebeamerDefs.h"
+#include "Beamformer.h"
+
+/** Render multichannel recordings through the Beamformer faster than real time
+ 
+ Each input file is split in chunks that are rendered in parallel, each by its own Beamformer.
+ A chunk starts a FIR length earlier than its first output sample, so that the result is the same as rendering
+ the whole file in one go. Input samples are read through memory mapped files when the format allows it.
+ One mono file is written per beam, next to the input or in the output directory: <name>-beam<n>.wav
+ 
+ Beams can follow an automation curve. As the whole trajectory is known in advance, the beam parameters of every
+ block are computed, quantized and deduplicated before rendering. Each chunk designs the distinct filters of its own
+ blocks before its rendering loop, which then only switches between them. Only the filters of the chunks in flight
+ are held, within filterMemoryBudget: a chunk with more distinct states than its share evicts the least recently
+ used filters and designs the missing ones as they are needed.
+ */
+class BatchRenderer {
+    
+public:
+    
+    /** Parse the command line options
+     
+     --render a,b,...         input files or directories
+     --beams x,y,w;x,y,w;...  direction and width of each beam, optionally followed by the focus distance, see BeamParameters
+     --automation file        CSV with lines beam,time,doaX,doaY,width[,distance]. Beams are numbered from 1, time is in seconds.
+                              Parameters are linearly interpolated between points and held before the first
+                              and after the last one. Beams without points keep the --beams parameters.
+     --config n|SxR           MicConfig index or eSticks per row times rows, e.g. 4x2.
+                              Guessed from the number of channels by default
+     --geometry file          microphone positions, see ArrayGeometry. Regular grid of eSticks by default
+     --nearfield d            closest focus distance [m], enables the distance of the beams
+     --block-size n           samples per processBlock
+     --chunk-seconds s        audio duration of a chunk [s]
+     --threads n              rendering threads, one per core by default
+     --output-dir dir         output directory, same as the input by default
+     */
+    explicit BatchRenderer(const ArgumentList &args);
+    
+    /** Render all the inputs
+     
+     @return: process exit code
+     */
+    int run();
+    
+private:
+    
+    /** A point of a beam automation curve */
+    typedef struct {
+        double time;
+        BeamParameters params;
+    } AutomationPoint;
+    
+    /** Quantized beam parameters of an input file */
+    struct FilterSchedule {
+        /** Distinct beam parameters */
+        std::vector<BeamParameters> states;
+        /** Index of the state of each beam at each block */
+        std::vector<std::vector<int>> blockStates;
+    };
+    
+    /** A portion of an input file, rendered independently */
+    struct Chunk {
+        int fileIdx;
+        /** First output sample */
+        int64 start;
+        /** Number of output samples */
+        int64 length;
+        /** Filters of the file */
+        std::shared_ptr<const FilterSchedule> schedule;
+        /** Rendered beams */
+        AudioBuffer<float> beams;
+        bool failed = false;
+        WaitableEvent done;
+    };
+    
+    /** Read the automation curves */
+    bool loadAutomation(const File &file);
+    
+    /** Parameters of a beam at a given time */
+    BeamParameters getBeamParameters(int beamIdx, double time) const;
+    
+    /** Compute and deduplicate the parameters of every block of a file */
+    std::shared_ptr<const FilterSchedule> createSchedule(int fileIdx) const;
+    
+    /** Render a chunk. Called by the worker threads. */
+    void renderChunk(Chunk &chunk);
+    
+    /** Open a reader for a section of a file, memory mapped if possible */
+    std::unique_ptr<AudioFormatReader> createReader(const File &file, Range<int64> section);
+    
+    /** Create the output files of an input */
+    bool createWriters(int fileIdx, std::vector<std::unique_ptr<AudioFormatWriter>> &writers) const;
+    
+    /** Input files, with their properties */
+    Array<File> inputFiles;
+    std::vector<int64> inputLengths;
+    std::vector<double> inputSampleRates;
+    std::vector<int> inputBitDepths;
+    std::vector<ArrayLayout> inputLayouts;
+    
+    std::vector<BeamParameters> beamParams = {{0, 0, 0.2f}};
+    
+    /** Automation curve of each beam, sorted by time. Empty for static beams. */
+    std::vector<std::vector<AutomationPoint>> automation;
+    
+    /** Quantization of the beam parameters. Parameters closer than this share the same filter. */
+    const float doaQuantization = 0.005f;
+    const float widthQuantization = 0.01f;
+    /** Distances are quantized in 1 / distance, as the focusing delays */
+    const float invDistanceQuantization = 0.01f;
+    
+    /** Layout, see parseArrayLayout. Empty to guess from the number of channels */
+    String config;
+    
+    /** Microphone positions file, empty for the regular grid of eSticks */
+    String geometryFile;
+    
+    /** Closest focus distance [m], 0 for far-field beams */
+    float nearfieldMinDistance = 0;
+    
+    /** Samples per processBlock. Chunks and parameter updates are aligned to blocks. */
+    int blockSize = 1024;
+    double chunkSeconds = 10;
+    int numThreads = 0;
+    File outputDir;
+    
+    /** Chunks rendered or waiting to be written at the same time */
+    int maxChunksInFlight = 1;
+    
+    /** Memory of the designed filters of all the chunks in flight [bytes] */
+    const int64 filterMemoryBudget = (int64) 1 << 30;
+    
+    AudioFormatManager formatManager;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (BatchRenderer)
+};
@@ -6,13 +6,19 @@
  */
 
 #include "Beamformer.h"
+#include "SharedInputAnalysis.h"
 
 BeamformerDoa::BeamformerDoa(Beamformer &b,
                              int numDoaHor_,
                              int numDoaVer_,
                              float sampleRate_,
                              int numActiveInputChannels,
-                             int firLen,
+                             int frameLen,
+                             float minFreq,
+                             float maxFreq,
+                             int numThreads_,
+                             int coarseStep_,
+                             int numPeaks_,
                              std::shared_ptr<dsp::FFT> fft_) : Thread("DOA"), beamformer(b) {
     
     numDoaHor = numDoaHor_;
@@ -20,73 +26,379 @@ BeamformerDoa::BeamformerDoa(Beamformer &b,
     fft = fft_;
     sampleRate = sampleRate_;
     
-    /** Initialize levels and FIR */
+    /** The DOA thread evaluates a shard too, the pool only the other ones */
+    numThreads = jlimit(1, numDoaHor * numDoaVer, numThreads_);
+    if (numThreads > 1) {
+        workers = std::make_unique<ThreadPool>(numThreads - 1);
+    }
+    
+    /** Initialize levels and energy accumulators */
     doaLevels.resize(numDoaVer,numDoaHor);
     doaLevels.setConstant(-100);
-    doaFirFFT.resize(numDoaHor*numDoaVer);
+    doaEnergy.resize(numDoaVer,numDoaHor);
+    doaEnergy.setZero();
+    
+    /** Energy is averaged over the whole update period */
+    numSamplesPerUpdate = roundToInt(sampleRate / ENERGY_UPDATE_FREQ);
+    numAccumulatedSamples = 0;
+    numElapsedSamples = 0;
+    
+    /** Allocate DOA frame */
+    doaFrame.setSize(numActiveInputChannels, frameLen);
+    doaFrame.clear();
     
     /** Allocate inputBuffer */
     inputBuffer = AudioBufferFFT(numActiveInputChannels, fft);
     
-    /** Allocate convolution buffer */
-    convolutionBuffer = AudioBufferFFT(1, fft);
+    /** DOA band, DC and Nyquist excluded */
+    const int fftSize = fft->getSize();
+    minBin = jlimit(1, fftSize / 2 - 1, (int) ceil(minFreq * fftSize / sampleRate));
+    const int maxBin = jlimit(minBin, fftSize / 2 - 1, (int) floor(maxFreq * fftSize / sampleRate));
+    numBins = maxBin - minBin + 1;
+    const Vec freqs = Vec::LinSpaced(numBins, minBin * sampleRate / fftSize, maxBin * sampleRate / fftSize);
+    inputSpectra.resize(numBins, numActiveInputChannels);
+    inputSpectra.setZero();
     
-    /** Allocate DOA beam */
-    doaBeam.setSize(1, fft->getSize());
-    
-    /** Compute FIR for DOA estimation */
-    AudioBuffer<float> tmpFir(numActiveInputChannels, firLen);
-    BeamParameters tmpBeamParams{0,0,0};
+    /** Steering tables. The horizontal part is computed broadside vertically and vice versa */
+    steeringHor.resize(numDoaHor);
+    steeringVer.resize(numDoaVer);
+    CpxMtx unusedSteering;
+    for (auto hDirIdx = 0; hDirIdx < numDoaHor; hDirIdx++) {
+        const BeamParameters params{-1 + (2.f / (numDoaHor - 1) * hDirIdx), 0, 0};
+        b.getDoaSteeringVectors(steeringHor[hDirIdx], unusedSteering, params, freqs);
+    }
     for (auto vDirIdx = 0; vDirIdx < numDoaVer; vDirIdx++) {
-        if (numDoaVer > 1){
-            tmpBeamParams.doaY = -1 + (2. / (numDoaVer - 1) * vDirIdx);
+        const BeamParameters params{0, numDoaVer > 1 ? -1 + (2.f / (numDoaVer - 1) * vDirIdx) : 0, 0};
+        b.getDoaSteeringVectors(unusedSteering, steeringVer[vDirIdx], params, freqs);
+    }
+    const int numRows = (int) steeringVer[0].cols();
+    jassert(steeringHor[0].cols() * numRows == numActiveInputChannels);
+    rowBeams.resize(numDoaHor);
+    for (auto &r : rowBeams) {
+        r.resize(numBins, numRows);
+        r.setZero();
+    }
+    
+    /** Coarse grid on each axis. The last direction is always part of it to avoid extrapolation */
+    coarseStep = jmax(1, coarseStep_);
+    auto makeCoarseAxis = [this](int numDoa, std::vector<int> &axis, std::vector<int> &low, std::vector<int> &high) {
+        axis.clear();
+        for (auto idx = 0; idx < numDoa; idx += coarseStep) {
+            axis.push_back(idx);
         }
-        for (auto hDirIdx = 0; hDirIdx < numDoaHor; hDirIdx++) {
-            tmpBeamParams.doaX = -1 + (2. / (numDoaHor - 1) * hDirIdx);
-            b.getFir(tmpFir, tmpBeamParams, 1);
-            auto dirIdx = vDirIdx * numDoaHor + hDirIdx;
-            doaFirFFT[dirIdx] = AudioBufferFFT(numActiveInputChannels, fft);
-            doaFirFFT[dirIdx].setTimeSeries(tmpFir);
-            doaFirFFT[dirIdx].prepareForConvolution();
+        if (axis.back() != numDoa - 1) {
+            axis.push_back(numDoa - 1);
+        }
+        low.resize(numDoa);
+        high.resize(numDoa);
+        for (auto pos = 0; pos + 1 < (int) axis.size(); pos++) {
+            for (auto idx = axis[pos]; idx <= axis[pos + 1]; idx++) {
+                low[idx] = axis[pos];
+                high[idx] = axis[pos + 1];
+            }
+        }
+        if (axis.size() == 1) {
+            low[0] = high[0] = 0;
         }
+    };
+    makeCoarseAxis(numDoaHor, coarseHor, coarseHorLow, coarseHorHigh);
+    makeCoarseAxis(numDoaVer, coarseVer, coarseVerLow, coarseVerHigh);
+    
+    /** Allocate directions and peaks bookkeeping, then start from the coarse grid only */
+    numPeaks = jmax(0, numPeaks_);
+    dirsToEvaluate.reserve(numDoaHor * numDoaVer);
+    dirIsEvaluated.resize(numDoaHor * numDoaVer);
+    horsToEvaluate.reserve(numDoaHor);
+    peakCandidates.reserve(numDoaHor * numDoaVer);
+    peaks.reserve(numPeaks);
+    peakDirIdxs.reserve(numPeaks);
+    selectDirections();
+    
+    /** Allocate a beam spectrum per thread */
+    beamSpectra.resize(numThreads);
+    for (auto &s : beamSpectra) {
+        s.resize(numBins);
     }
 }
 
+void BeamformerDoa::notifyInputReady() {
+    /** Thread::notify takes a lock, the audio thread only sets the flag */
+    wakeupPending.store(true, std::memory_order_release);
+}
+
 void BeamformerDoa::run() {
     
+    /** Processing time spent during the current update period [ticks] */
+    int64 updateTicks = 0;
+    
+    /** Position of the next frame within frameStride */
+    int strideIdx = 0;
+    
     while (!threadShouldExit()){
         
-        const auto startTick = Time::getHighResolutionTicks();
+        /** Cleared before reading, a notification arriving meanwhile makes the next wait return immediately */
+        wakeupPending.store(false, std::memory_order_relaxed);
         
-        beamformer.getDoaInputBuffer(inputBuffer);
+        /** Accumulate the energy of one frame out of frameStride, discard the other ones.
+         Only the FIFO read happens concurrently with the audio thread, FFTs are computed on a private copy.
+         */
+        while (!threadShouldExit()) {
+            
+            if (strideIdx > 0) {
+                if (!beamformer.discardDoaInputFrame(doaFrame.getNumSamples())) {
+                    break;
+                }
+                strideIdx = (strideIdx + 1) % frameStride;
+                numElapsedSamples += doaFrame.getNumSamples();
+                continue;
+            }
+            
+            if (!beamformer.getDoaInputFrame(doaFrame)) {
+                break;
+            }
+            strideIdx = (strideIdx + 1) % frameStride;
+            numElapsedSamples += doaFrame.getNumSamples();
+            
+            ScopedTrace trace(beamformer.getTraceRecorder(), "doaFrame", "doa");
+            
+            const auto startTick = Time::getHighResolutionTicks();
+            
+            /** The real-only forward transform leaves interleaved complex bins */
+            inputBuffer.setTimeSeries(doaFrame);
+            for (auto chIdx = 0; chIdx < inputBuffer.getNumChannels(); chIdx++) {
+                const auto *bins = reinterpret_cast<const std::complex<float> *>(inputBuffer.getReadPointer(chIdx));
+                inputSpectra.col(chIdx) = Eigen::Map<const CpxVec>(bins + minBin, numBins);
+            }
+            
+            evaluateAllDirections();
+            numAccumulatedSamples += doaFrame.getNumSamples();
+            
+            updateTicks += Time::getHighResolutionTicks() - startTick;
+        }
         
-        /** Compute DOA levels */
+        /** Publish the average power over the update period */
+        if (numElapsedSamples >= numSamplesPerUpdate * frameStride) {
+            ScopedTrace trace(beamformer.getTraceRecorder(), "doaUpdate", "doa");
+            for (auto dirIdx : dirsToEvaluate) {
+                const int vDirIdx = dirIdx / numDoaHor;
+                const int hDirIdx = dirIdx % numDoaHor;
+                const float dirPower = doaEnergy(vDirIdx,hDirIdx) / numAccumulatedSamples;
+                doaLevels(vDirIdx,hDirIdx) = Decibels::gainToDecibels(std::sqrt(dirPower));
+            }
+            interpolateLevels();
+            findPeaks();
+            beamformer.setDoaEnergy(doaLevels, peaks);
+            beamformer.setDoaUpdateTime(Time::highResolutionTicksToSeconds(updateTicks));
+            adaptFrameStride(Time::highResolutionTicksToSeconds(updateTicks), numElapsedSamples / sampleRate);
+            doaEnergy.setZero();
+            numAccumulatedSamples = 0;
+            numElapsedSamples = 0;
+            strideIdx = 0;
+            updateTicks = 0;
+            
+            /** Peaks move slowly, refine around the ones just found during the next update period */
+            selectDirections();
+        }
+        
+        /** Sleep until the audio thread flags new input. stopThread still wakes the wait right away */
+        while (!threadShouldExit() && !wakeupPending.load(std::memory_order_acquire)) {
+            wait(wakeupPollMs);
+        }
+        
+    }
+}
+
+void BeamformerDoa::adaptFrameStride(double busyTime, double updatePeriod) {
+    
+    const float budget = beamformer.getDoaCpuBudget();
+    const float dutyCycle = updatePeriod > 0 ? busyTime / updatePeriod : 0;
+    
+    /** Halving the stride would double the duty cycle, do it only if it still fits the budget */
+    if (dutyCycle > budget) {
+        frameStride = jmin(maxFrameStride, frameStride * 2);
+    } else if (frameStride > 1 && 2 * dutyCycle < strideDecreaseMargin * budget) {
+        frameStride /= 2;
+    }
+}
+
+void BeamformerDoa::evaluateAllDirections() {
+    
+    /** Rows first, then directions. Each shard writes to its own entries of rowBeams and doaEnergy */
+    runSharded((int) horsToEvaluate.size(), [this](int, int firstPos, int endPos) {
+        beamformRows(firstPos, endPos);
+    });
+    runSharded((int) dirsToEvaluate.size(), [this](int threadIdx, int firstPos, int endPos) {
+        evaluateDirections(threadIdx, firstPos, endPos);
+    });
+}
+
+void BeamformerDoa::runSharded(int numItems, const std::function<void(int, int, int)> &fn) {
+    
+    /** The DOA thread evaluates the first shard while the workers evaluate the other ones */
+    numPendingShards = numThreads - 1;
+    for (auto shardIdx = 1; shardIdx < numThreads; shardIdx++) {
+        workers->addJob([this, &fn, shardIdx, numItems] {
+            fn(shardIdx, numItems * shardIdx / numThreads, numItems * (shardIdx + 1) / numThreads);
+            if (--numPendingShards == 0) {
+                shardsDone.signal();
+            }
+        });
+    }
+    
+    fn(0, 0, numItems / numThreads);
+    
+    if (numThreads > 1) {
+        shardsDone.wait();
+    }
+}
+
+void BeamformerDoa::beamformRows(int firstPos, int endPos) {
+    
+    const int numMicPerRow = (int) steeringHor[0].cols();
+    
+    for (auto pos = firstPos; pos < endPos; pos++) {
+        const int hDirIdx = horsToEvaluate[pos];
+        CpxMtx &rowBeam = rowBeams[hDirIdx];
+        for (auto rowIdx = 0; rowIdx < rowBeam.cols(); rowIdx++) {
+            rowBeam.col(rowIdx) = steeringHor[hDirIdx].cwiseProduct(
+                    inputSpectra.middleCols(rowIdx * numMicPerRow, numMicPerRow)).rowwise().sum();
+        }
+    }
+}
+
+void BeamformerDoa::evaluateDirections(int threadIdx, int firstPos, int endPos) {
+    
+    CpxVec &beamSpectrum = beamSpectra[threadIdx];
+    
+    /** Only the positive frequencies are stored, the negative ones contribute the same energy (Parseval) */
+    const float energyScale = 2.f / fft->getSize();
+    
+    for (auto pos = firstPos; pos < endPos; pos++) {
+        const int dirIdx = dirsToEvaluate[pos];
+        const int vDirIdx = dirIdx / numDoaHor;
+        const int hDirIdx = dirIdx % numDoaHor;
+        beamSpectrum.noalias() = steeringVer[vDirIdx].cwiseProduct(rowBeams[hDirIdx]).rowwise().sum();
+        doaEnergy(vDirIdx, hDirIdx) += energyScale * beamSpectrum.squaredNorm();
+    }
+}
+
+void BeamformerDoa::selectDirections() {
+    
+    std::fill(dirIsEvaluated.begin(), dirIsEvaluated.end(), false);
+    
+    for (auto vDirIdx : coarseVer) {
+        for (auto hDirIdx : coarseHor) {
+            dirIsEvaluated[vDirIdx * numDoaHor + hDirIdx] = true;
+        }
+    }
+    
+    /** Evaluate every direction up to the neighbouring coarse directions of each peak */
+    for (auto peakDirIdx : peakDirIdxs) {
+        const int vPeakIdx = peakDirIdx / numDoaHor;
+        const int hPeakIdx = peakDirIdx % numDoaHor;
+        for (auto vDirIdx = jmax(0, vPeakIdx - coarseStep); vDirIdx <= jmin(numDoaVer - 1, vPeakIdx + coarseStep); vDirIdx++) {
+            for (auto hDirIdx = jmax(0, hPeakIdx - coarseStep); hDirIdx <= jmin(numDoaHor - 1, hPeakIdx + coarseStep); hDirIdx++) {
+                dirIsEvaluated[vDirIdx * numDoaHor + hDirIdx] = true;
+            }
+        }
+    }
+    
+    dirsToEvaluate.clear();
+    for (auto dirIdx = 0; dirIdx < (int) dirIsEvaluated.size(); dirIdx++) {
+        if (dirIsEvaluated[dirIdx]) {
+            dirsToEvaluate.push_back(dirIdx);
+        }
+    }
+    
+    horsToEvaluate.clear();
+    for (auto hDirIdx = 0; hDirIdx < numDoaHor; hDirIdx++) {
         for (auto vDirIdx = 0; vDirIdx < numDoaVer; vDirIdx++) {
-            for (auto hDirIdx = 0; hDirIdx < numDoaHor; hDirIdx++) {
-                auto dirIdx = vDirIdx * numDoaHor + hDirIdx;
-                doaBeam.clear();
-                for (auto inCh = 0; inCh < inputBuffer.getNumChannels(); inCh++) {
-                    /** Convolve inputs and DOA FIR */
-                    convolutionBuffer.convolve(0, inputBuffer, inCh, doaFirFFT[dirIdx], inCh);
-                    convolutionBuffer.addToTimeSeries(0, doaBeam, 0);
+            if (dirIsEvaluated[vDirIdx * numDoaHor + hDirIdx]) {
+                horsToEvaluate.push_back(hDirIdx);
+                break;
+            }
+        }
+    }
+}
+
+void BeamformerDoa::interpolateLevels() {
+    
+    /** Bilinear interpolation in dB of the closest coarse directions, which are always evaluated */
+    for (auto vDirIdx = 0; vDirIdx < numDoaVer; vDirIdx++) {
+        const int v0 = coarseVerLow[vDirIdx];
+        const int v1 = coarseVerHigh[vDirIdx];
+        const float wv = v1 > v0 ? float(vDirIdx - v0) / (v1 - v0) : 0;
+        for (auto hDirIdx = 0; hDirIdx < numDoaHor; hDirIdx++) {
+            if (dirIsEvaluated[vDirIdx * numDoaHor + hDirIdx]) {
+                continue;
+            }
+            const int h0 = coarseHorLow[hDirIdx];
+            const int h1 = coarseHorHigh[hDirIdx];
+            const float wh = h1 > h0 ? float(hDirIdx - h0) / (h1 - h0) : 0;
+            const float levelV0 = (1 - wh) * doaLevels(v0, h0) + wh * doaLevels(v0, h1);
+            const float levelV1 = (1 - wh) * doaLevels(v1, h0) + wh * doaLevels(v1, h1);
+            doaLevels(vDirIdx, hDirIdx) = (1 - wv) * levelV0 + wv * levelV1;
+        }
+    }
+}
+
+/** Offset of the vertex of the parabola through three equally spaced points, relative to the central one */
+static float parabolicPeakOffset(float prev, float centre, float next) {
+    const float den = prev - 2 * centre + next;
+    if (den >= 0) {
+        return 0;
+    }
+    return jlimit(-0.5f, 0.5f, 0.5f * (prev - next) / den);
+}
+
+void BeamformerDoa::findPeaks() {
+    
+    /** Local maxima. Ties are broken in favour of the first direction to avoid duplicate peaks on plateaus */
+    peakCandidates.clear();
+    for (auto vDirIdx = 0; vDirIdx < numDoaVer; vDirIdx++) {
+        for (auto hDirIdx = 0; hDirIdx < numDoaHor; hDirIdx++) {
+            const float level = doaLevels(vDirIdx, hDirIdx);
+            bool isMax = true;
+            for (auto vNear = jmax(0, vDirIdx - 1); isMax && vNear <= jmin(numDoaVer - 1, vDirIdx + 1); vNear++) {
+                for (auto hNear = jmax(0, hDirIdx - 1); isMax && hNear <= jmin(numDoaHor - 1, hDirIdx + 1); hNear++) {
+                    const bool isBefore = vNear * numDoaHor + hNear < vDirIdx * numDoaHor + hDirIdx;
+                    const float nearLevel = doaLevels(vNear, hNear);
+                    isMax = isBefore ? level > nearLevel : level >= nearLevel;
                 }
-                
-                const Range<float> minMax = FloatVectorOperations::findMinAndMax(doaBeam.getReadPointer(0),
-                                                                                 doaBeam.getNumSamples());
-                const float dirEnergy = jmax(abs(minMax.getStart()), abs(minMax.getEnd()));
-                const float dirEnergyDb = Decibels::gainToDecibels(dirEnergy);
-                doaLevels(vDirIdx,hDirIdx) = dirEnergyDb;
+            }
+            if (isMax) {
+                peakCandidates.push_back({level, vDirIdx * numDoaHor + hDirIdx});
             }
         }
-        beamformer.setDoaEnergy(doaLevels);
+    }
+    
+    const int numFound = jmin(numPeaks, (int) peakCandidates.size());
+    std::partial_sort(peakCandidates.begin(), peakCandidates.begin() + numFound, peakCandidates.end(),
+                      [](const std::pair<float, int> &a, const std::pair<float, int> &b) { return a.first > b.first; });
+    
+    peaks.clear();
+    peakDirIdxs.clear();
+    for (auto peakIdx = 0; peakIdx < numFound; peakIdx++) {
+        const int dirIdx = peakCandidates[peakIdx].second;
+        const int vDirIdx = dirIdx / numDoaHor;
+        const int hDirIdx = dirIdx % numDoaHor;
         
-        const auto endTick = Time::getHighResolutionTicks();
-        const float elapsedTime = Time::highResolutionTicksToSeconds(endTick-startTick);
-        const float expectedPeriod = 1.f/ENERGY_UPDATE_FREQ;
-        if (elapsedTime < expectedPeriod){
-            Time::waitForMillisecondCounter(Time::getMillisecondCounter() + (expectedPeriod-elapsedTime));
+        float hOffset = 0, vOffset = 0;
+        if (hDirIdx > 0 && hDirIdx < numDoaHor - 1) {
+            hOffset = parabolicPeakOffset(doaLevels(vDirIdx, hDirIdx - 1), doaLevels(vDirIdx, hDirIdx),
+                                          doaLevels(vDirIdx, hDirIdx + 1));
+        }
+        if (vDirIdx > 0 && vDirIdx < numDoaVer - 1) {
+            vOffset = parabolicPeakOffset(doaLevels(vDirIdx - 1, hDirIdx), doaLevels(vDirIdx, hDirIdx),
+                                          doaLevels(vDirIdx + 1, hDirIdx));
         }
         
+        DoaPeak peak;
+        peak.doaX = -1 + (2.f / (numDoaHor - 1)) * (hDirIdx + hOffset);
+        peak.doaY = numDoaVer > 1 ? -1 + (2.f / (numDoaVer - 1)) * (vDirIdx + vOffset) : 0;
+        peak.energy = peakCandidates[peakIdx].first;
+        peaks.push_back(peak);
+        peakDirIdxs.push_back(dirIdx);
     }
 }
 
@@ -95,12 +407,38 @@ BeamformerDoa::~BeamformerDoa(){
 }
 
 // ==============================================================================
-Beamformer::Beamformer(int numBeams_, MicConfig mic, double sampleRate_, int maximumExpectedSamplesPerBlock_) {
+BeamformerRenderWorker::BeamformerRenderWorker(Beamformer &b, int shardIdx_) : Thread("Beams render"), beamformer(b) {
+    shardIdx = shardIdx_;
+}
+
+BeamformerRenderWorker::~BeamformerRenderWorker() {
+    signalThreadShouldExit();
+    blockReady.signal();
+    stopThread(1000);
+}
+
+void BeamformerRenderWorker::run() {
+    while (!threadShouldExit()) {
+        blockReady.wait();
+        if (threadShouldExit())
+            break;
+        beamformer.renderShard(shardIdx);
+    }
+}
+
+void BeamformerRenderWorker::notifyBlockReady() {
+    blockReady.signal();
+}
+
+// ==============================================================================
+Beamformer::Beamformer(int numBeams_, const ArrayLayout &layout, double sampleRate_, int maximumExpectedSamplesPerBlock_,
+                       const BeamformerSettings &settings_) {
     
     numBeams = numBeams_;
-    numDoaVer = isLinearArray(mic) ? 1 : NUM_DOAY;
-    numDoaHor = NUM_DOAX;
-    micConfig = mic;
+    settings = settings_;
+    numDoaVer = isLinearArray(layout) ? 1 : jmax(2, settings.doaGridY);
+    numDoaHor = jmax(2, settings.doaGridX);
+    arrayLayout = layout;
     sampleRate = sampleRate_;
     maximumExpectedSamplesPerBlock = maximumExpectedSamplesPerBlock_;
     
@@ -115,41 +453,35 @@ Beamformer::Beamformer(int numBeams_, MicConfig mic, double sampleRate_, int max
     const float micDistY = 0.03;
     
     /** Determine configuration parameters */
-    switch (micConfig) {
-        case ULA_1ESTICK:
-            numMic = 16;
-            numRows = 1;
-            break;
-        case ULA_2ESTICK:
-            numMic = 32;
-            numRows = 1;
-            break;
-        case URA_2ESTICK:
-            numMic = 32;
-            numRows = 2;
-            break;
-        case ULA_3ESTICK:
-            numMic = 48;
-            numRows = 1;
-            break;
-        case URA_3ESTICK:
-            numMic = 48;
-            numRows = 3;
-            break;
-        case ULA_4ESTICK:
-            numMic = 64;
-            numRows = 1;
-            break;
-        case URA_4ESTICK:
-            numMic = 64;
-            numRows = 4;
-            break;
-        case URA_2x2ESTICK:
-            numMic = 64;
-            numRows = 2;
-            break;
+    numMic = ::getNumMics(arrayLayout);
+    numRows = getNumRows(arrayLayout);
+    alg = nullptr;
+    /** Beams follow the measured positions, DOA keeps the regular grid as its steering must be separable */
+    ArrayGeometry geometry;
+    bool customGeometry = false;
+    if (settings.geometryFile.isNotEmpty()) {
+        const String error = geometry.loadFromFile(File(settings.geometryFile));
+        customGeometry = error.isEmpty() && geometry.getNumMics() == numMic;
+        if (!customGeometry) {
+            DBG("Ignoring geometry " << settings.geometryFile << ": "
+                << (error.isNotEmpty() ? error : String(geometry.getNumMics()) + " microphones instead of " + String(numMic)));
+        }
+    }
+    if (!customGeometry) {
+        geometry = ArrayGeometry::fromArrayLayout(arrayLayout, micDistX, micDistY);
+    }
+    if (settings.nearfieldMinDistance > 0) {
+        alg = std::make_unique<DAS::NearfieldGeometry>(geometry, sampleRate, soundspeed, settings.nearfieldMinDistance,
+                                                       (numDoaHor - 1) * nearfieldTableRefinement + 1,
+                                                       (numDoaVer - 1) * nearfieldTableRefinement + 1,
+                                                       nearfieldTableDistances);
+    } else if (customGeometry) {
+        alg = std::make_unique<DAS::FarfieldGeometry>(geometry, sampleRate, soundspeed,
+                                                      (numDoaHor - 1) * geometryTableRefinement + 1,
+                                                      (numDoaVer - 1) * geometryTableRefinement + 1);
+    } else {
+        alg = std::make_unique<DAS::FarfieldURA>(micDistX, micDistY, numMic, numRows, sampleRate, soundspeed);
     }
-    alg = std::make_unique<DAS::FarfieldURA>(micDistX, micDistY, numMic, numRows, sampleRate, soundspeed);
     
     firLen = alg->getFirLen();
     
@@ -169,81 +501,323 @@ Beamformer::Beamformer(int numBeams_, MicConfig mic, double sampleRate_, int max
     /** Allocate input buffers */
     inputBuffer = AudioBufferFFT(numMic, fft);
     
-    /** Allocate convolution buffer */
-    convolutionBuffer = AudioBufferFFT(1, fft);
+    /** Allocate the beam spectra of each render shard. Large arrays need more than a core to meet real time */
+    const int autoRenderThreads = numMic > 4 * ESTICK_NUM_MICS ? jlimit(1, 4, SystemStats::getNumCpus() / 2) : 1;
+    numRenderShards = jlimit(1, numMic, settings.renderNumThreads > 0 ? settings.renderNumThreads : autoRenderThreads);
+    shardSpectra.clear();
+    shardDoneBlockIdx.reset(new std::atomic<int64>[numRenderShards]);
+    for (auto shardIdx = 0; shardIdx < numRenderShards; shardIdx++) {
+        shardSpectra.emplace_back(numBeams, fft);
+        shardDoneBlockIdx[shardIdx] = 0;
+    }
+    if (numRenderShards > 1) {
+        lateShardSpectra = AudioBufferFFT(numBeams, fft);
+    }
     
     /** Allocate beam output buffer */
-    beamBuffer.setSize(numBeams, convolutionBuffer.getNumSamples() / 2);
+    beamBuffer.setSize(numBeams, fft->getSize());
     beamBuffer.clear();
     
-    /** Allocate DOA input buffer */
+    /** Start the render workers */
+    for (auto shardIdx = 1; shardIdx < numRenderShards; shardIdx++) {
+        renderWorkers.push_back(std::make_unique<BeamformerRenderWorker>(*this, shardIdx));
+        renderWorkers.back()->startThread(Thread::realtimeAudioPriority);
+    }
+    
+    /** The DOA input is band-limited, hence DOA runs on a decimated signal with its own filters */
+    doaDecimation = jmax(1, (int) floor(sampleRate / doaMinSampleRate));
+    doaDecimationPhase = 0;
+    doaSampleRate = sampleRate / doaDecimation;
+    doaAlg = std::make_unique<DAS::FarfieldURA>(micDistX, micDistY, numMic, numRows, doaSampleRate, soundspeed);
+    /** Frames at least as long as the array aperture, transformed without zero padding */
+    doaFrameLen = nextPowerOfTwo(doaAlg->getFirLen());
+    doaFft = std::make_shared<juce::dsp::FFT>(roundToInt(log2(doaFrameLen)));
+    
+    /** Allocate DOA input buffers */
     doaInputBuffer.setSize(numMic, maximumExpectedSamplesPerBlock);
     doaInputBuffer.clear();
+    doaDecimatedBuffer.setSize(numMic, maximumExpectedSamplesPerBlock / doaDecimation + 1);
+    doaDecimatedBuffer.clear();
     
-    /** Set DOA input Filter  */
+    /** Set DOA input Filter */
     doaBPFilters.clear();
-    doaBPFilters.resize(numMic);
+    doaBPFilters.resize(numMic * doaBPNumStages);
     IIRCoefficients doaIIRCoeff = IIRCoefficients::makeBandPass(sampleRate, doaBPfreq, doaBPQ);
     for (auto &f : doaBPFilters) {
         f.setCoefficients(doaIIRCoeff);
     }
     
-    /** Prepare and start DOA thread */
-    doaThread = std::make_unique<BeamformerDoa>(*this, numDoaHor, numDoaVer, sampleRate, numMic, firLen, fft);
-    doaThread->startThread();
+    /** Set DOA anti-aliasing filter, a Butterworth low pass of order 2 * doaLPNumStages as cascaded sections */
+    doaLPFilters.clear();
+    doaLPFilters.resize(numMic * doaLPNumStages);
+    for (auto stageIdx = 0; stageIdx < doaLPNumStages; stageIdx++) {
+        const double q = 1 / (2 * sin((2 * stageIdx + 1) * MathConstants<double>::pi / (4 * doaLPNumStages)));
+        const IIRCoefficients doaLPCoeff = IIRCoefficients::makeLowPass(sampleRate, doaLPfreq, q);
+        for (auto micIdx = 0; micIdx < numMic; micIdx++) {
+            doaLPFilters[micIdx * doaLPNumStages + stageIdx].setCoefficients(doaLPCoeff);
+        }
+    }
+    
+    /** Preallocate the published DOA maps */
+    doaMaps.forEach([this](DoaMap &map) {
+        map.levels = Mtx::Constant(numDoaVer, numDoaHor, -100);
+        map.peaks.reserve(jmax(1, settings.doaNumPeaks));
+    });
+    
+    /** Instances sharing their input only start the DOA thread if they lead their group, see setSharedInput */
+    if (settings.arrayId.isEmpty())
+        startDoa();
+    
+}
+
+void Beamformer::startDoa() {
+    if (!settings.doaEnabled || doaThread != nullptr)
+        return;
     
+    /** Allocate DOA input FIFO, large enough to hold a couple of DOA update periods */
+    const int doaFifoLen = jmax(4 * doaFrameLen, 2 * roundToInt(doaSampleRate / doaUpdateFrequency));
+    doaInputFifo = std::make_unique<AudioBufferFifo>(numMic, doaFifoLen);
+    
+    /** Prepare and start DOA thread, then hand it to the audio thread */
+    const int doaNumThreads = settings.doaNumThreads > 0 ? settings.doaNumThreads : jlimit(1, 4, SystemStats::getNumCpus() / 2);
+    doaThread = std::make_unique<BeamformerDoa>(*this, numDoaHor, numDoaVer, doaSampleRate, numMic, doaFrameLen,
+                                                doaBPfreq / 2, doaBPfreq * 2, doaNumThreads, settings.doaCoarseStep,
+                                                settings.doaNumPeaks, doaFft);
+    doaThread->startThread();
+    activeDoaThread = doaThread.get();
 }
 
 Beamformer::~Beamformer() {
-    doaThread->stopThread(3000);
+    if (doaThread != nullptr)
+        doaThread->stopThread(3000);
+    renderWorkers.clear();
+}
+
+ArrayLayout Beamformer::getArrayLayout() const {
+    return arrayLayout;
+}
+
+int Beamformer::getFirLen() const {
+    return firLen;
 }
 
-MicConfig Beamformer::getMicConfig() const {
-    return micConfig;
+int Beamformer::getNumMics() const {
+    return numMic;
+}
+
+int Beamformer::getFftSize() const {
+    return fft->getSize();
 }
 
 
-void Beamformer::setBeamParameters(int beamIdx, const BeamParameters &beamParams) {
+void Beamformer::setBeamParameters(int beamIdx, const BeamParameters &beamParams, bool smooth) {
     if (alg == nullptr)
         return;
-    alg->getFir(firIR[beamIdx], beamParams, alpha);
+    ScopedStageTimer timer(profiler, STAGE_FIR_DESIGN);
+    ScopedTrace trace(traceRecorder, "firDesign", "audio");
+    alg->getFir(firIR[beamIdx], beamParams, smooth ? alpha : 1);
     firFFT[beamIdx].setTimeSeries(firIR[beamIdx]);
     firFFT[beamIdx].prepareForConvolution();
 }
 
 void Beamformer::processBlock(const AudioBuffer<float> &inBuffer) {
     
-    {
-        GenericScopedLock<SpinLock> lock(doaInputBufferLock);
+    /** Band-pass and decimate the DOA input on private buffers, then hand it over to the DOA thread without locking.
+     If the DOA thread is lagging behind the FIFO is full and the new samples are dropped.
+     */
+    const int numSamples = inBuffer.getNumSamples();
+    auto *doa = activeDoaThread.load();
+    if (doa != nullptr && (sharedInput == nullptr || sharedInput->isLeader(this))) {
+        ScopedStageTimer timer(profiler, STAGE_INPUT_CONDITIONING);
+        ScopedTrace trace(traceRecorder, "doaInput", "audio");
+        const int firstDecimatedIdx = (doaDecimation - doaDecimationPhase) % doaDecimation;
+        const int numDecimated = firstDecimatedIdx < numSamples ? (numSamples - firstDecimatedIdx - 1) / doaDecimation + 1 : 0;
         for (auto chIdx = 0; chIdx < jmin(numMic, inBuffer.getNumChannels()); chIdx++) {
-            doaInputBuffer.copyFrom(chIdx, 0, inBuffer, chIdx, 0, inBuffer.getNumSamples());
-            doaBPFilters[chIdx].processSamples(doaInputBuffer.getWritePointer(chIdx), inBuffer.getNumSamples());
+            doaInputBuffer.copyFrom(chIdx, 0, inBuffer, chIdx, 0, numSamples);
+            for (auto stageIdx = 0; stageIdx < doaBPNumStages; stageIdx++) {
+                doaBPFilters[chIdx * doaBPNumStages + stageIdx].processSamples(doaInputBuffer.getWritePointer(chIdx),
+                                                                                numSamples);
+            }
+            for (auto stageIdx = 0; stageIdx < doaLPNumStages; stageIdx++) {
+                doaLPFilters[chIdx * doaLPNumStages + stageIdx].processSamples(doaInputBuffer.getWritePointer(chIdx),
+                                                                                numSamples);
+            }
+            const float *src = doaInputBuffer.getReadPointer(chIdx);
+            float *dst = doaDecimatedBuffer.getWritePointer(chIdx);
+            for (auto idx = 0; idx < numDecimated; idx++) {
+                dst[idx] = src[firstDecimatedIdx + idx * doaDecimation];
+            }
+        }
+        doaDecimationPhase = (doaDecimationPhase + numSamples) % doaDecimation;
+        doaInputFifo->push(doaDecimatedBuffer, 0, numDecimated);
+        if (doaInputFifo->getNumReady() >= doaFrameLen) {
+            doa->notifyInputReady();
+        }
+    }
+    
+    /** Compute inputs FFT, unless another instance of the same array already did */
+    const AudioBufferFFT *spectra = &inputBuffer;
+    int sharedSlot = -1;
+    {
+        ScopedStageTimer timer(profiler, STAGE_FORWARD_FFT);
+        if (sharedInput != nullptr && (sharedSlot = sharedInput->acquire(inBuffer)) >= 0) {
+            spectra = &sharedInput->getSpectra(sharedSlot);
+        } else {
+            inputBuffer.setTimeSeries(inBuffer);
+            inputBuffer.prepareForConvolution();
+            if (sharedInput != nullptr)
+                sharedInput->publish(inBuffer, inputBuffer);
         }
     }
     
-    /** Compute inputs FFT */
-    inputBuffer.setTimeSeries(inBuffer);
-    inputBuffer.prepareForConvolution();
+    ScopedTrace trace(traceRecorder, "beams", "audio");
     
-    for (auto beamIdx = 0; beamIdx < numBeams; beamIdx++) {
-        for (auto inCh = 0; inCh < inputBuffer.getNumChannels(); inCh++) {
-            /** Convolve inputs and FIR */
-            convolutionBuffer.convolve(0, inputBuffer, inCh, firFFT[beamIdx], inCh);
-            /** Overlap and add of convolutionBuffer into beamBuffer */
-            convolutionBuffer.addToTimeSeries(0, beamBuffer, beamIdx);
+    /** Sum inputs convolved with the FIRs in frequency domain. The microphones are split in shards,
+     the audio thread renders the first one while the workers render the other ones.
+     The audio thread never blocks on the workers: it spins on their completion for about as long as its own shard
+     took, then renders the shards still missing itself.
+     */
+    {
+        ScopedStageTimer timer(profiler, STAGE_MAC);
+        renderSpectra.store(spectra, std::memory_order_relaxed);
+        const int64 blockIdx = renderBlockIdx.load(std::memory_order_relaxed) + 1;
+        renderBlockIdx.store(blockIdx, std::memory_order_release);
+        for (auto &worker : renderWorkers) {
+            worker->notifyBlockReady();
+        }
+        const int64 startTicks = Time::getHighResolutionTicks();
+        renderShard(0);
+        const int64 shardTicks = Time::getHighResolutionTicks() - startTicks;
+        const int64 deadlineTicks = startTicks + shardTicks
+                                    + jmax(shardTicks, Time::secondsToHighResolutionTicks(renderSpinMinSeconds));
+        for (auto shardIdx = 1; shardIdx < numRenderShards; shardIdx++) {
+            bool done;
+            while (!(done = shardDoneBlockIdx[shardIdx].load(std::memory_order_acquire) == blockIdx)
+                   && Time::getHighResolutionTicks() < deadlineTicks) {
+            }
+            const AudioBufferFFT *beamSpectra = &shardSpectra[shardIdx];
+            if (!done) {
+                /** The worker is late, its shardSpectra are left alone and its result for this block discarded */
+                convolveShard(shardIdx, *spectra, lateShardSpectra);
+                beamSpectra = &lateShardSpectra;
+            }
+            for (auto beamIdx = 0; beamIdx < numBeams; beamIdx++) {
+                FloatVectorOperations::add(shardSpectra[0].getWritePointer(beamIdx),
+                                           beamSpectra->getReadPointer(beamIdx),
+                                           shardSpectra[0].getNumSamples());
+            }
+        }
+    }
+    
+    /** A single inverse FFT per beam, overlapped and added into beamBuffer */
+    {
+        ScopedStageTimer timer(profiler, STAGE_INVERSE_FFT);
+        for (auto beamIdx = 0; beamIdx < numBeams; beamIdx++) {
+            shardSpectra[0].addToTimeSeries(beamIdx, beamBuffer, beamIdx);
         }
     }
     
+    if (sharedSlot >= 0)
+        sharedInput->release(sharedSlot);
+    
+}
+
+void Beamformer::renderShard(int shardIdx) {
+    const int64 blockIdx = renderBlockIdx.load(std::memory_order_acquire);
+    if (shardDoneBlockIdx[shardIdx].load(std::memory_order_relaxed) == blockIdx) {
+        return;
+    }
+    convolveShard(shardIdx, *renderSpectra.load(std::memory_order_relaxed), shardSpectra[shardIdx]);
+    shardDoneBlockIdx[shardIdx].store(blockIdx, std::memory_order_release);
+}
+
+void Beamformer::convolveShard(int shardIdx, const AudioBufferFFT &spectra, AudioBufferFFT &beamSpectra) {
+    const int numChannels = spectra.getNumChannels();
+    const int firstCh = numChannels * shardIdx / numRenderShards;
+    const int endCh = numChannels * (shardIdx + 1) / numRenderShards;
+    if (firstCh == endCh) {
+        beamSpectra.clear();
+    } else {
+        for (auto beamIdx = 0; beamIdx < numBeams; beamIdx++) {
+            beamSpectra.convolve(beamIdx, spectra, firstCh, firFFT[beamIdx], firstCh);
+            for (auto inCh = firstCh + 1; inCh < endCh; inCh++) {
+                beamSpectra.addConvolution(beamIdx, spectra, inCh, firFFT[beamIdx], inCh);
+            }
+        }
+    }
 }
 
 void Beamformer::getFir(AudioBuffer<float> &fir, const BeamParameters &params, float alpha) const {
     alg->getFir(fir, params, alpha);
 }
 
-void Beamformer::getDoaInputBuffer(AudioBufferFFT &dst) const {
-    GenericScopedLock<SpinLock> lock(doaInputBufferLock);
-    dst.setTimeSeries(doaInputBuffer);
-    dst.prepareForConvolution();
+void Beamformer::getFirFFT(AudioBufferFFT &firFFT, const BeamParameters &params) const {
+    AudioBuffer<float> fir(numMic, firLen);
+    alg->getFir(fir, params);
+    auto firFft = fft;
+    firFFT = AudioBufferFFT(fir, firFft);
+    firFFT.prepareForConvolution();
+}
+
+void Beamformer::setBeamFir(int beamIdx, const AudioBufferFFT &fir) {
+    jassert(fir.getNumChannels() == firFFT[beamIdx].getNumChannels());
+    jassert(fir.getNumSamples() == firFFT[beamIdx].getNumSamples());
+    firFFT[beamIdx] = fir;
+}
+
+void Beamformer::getDoaSteeringVectors(CpxMtx &steeringX, CpxMtx &steeringY, const BeamParameters &params,
+                                       const Vec &freqs) const {
+    doaAlg->getSteeringVectors(steeringX, steeringY, params, freqs);
+}
+
+bool Beamformer::setSharedInput(SharedInputAnalysis *group) {
+    if (group != nullptr && !group->prepare(inputBuffer, maximumExpectedSamplesPerBlock)) {
+        sharedInput = nullptr;
+        startDoa();
+        return false;
+    }
+    sharedInput = group;
+    if (group == nullptr || group->isLeader(this))
+        startDoa();
+    return true;
+}
+
+bool Beamformer::getDoaInputFrame(AudioBuffer<float> &frame) {
+    if (doaInputFifo->getNumReady() < frame.getNumSamples()) {
+        return false;
+    }
+    doaInputFifo->pop(frame, 0, frame.getNumSamples());
+    return true;
+}
+
+bool Beamformer::discardDoaInputFrame(int numSamples) {
+    if (doaInputFifo->getNumReady() < numSamples) {
+        return false;
+    }
+    doaInputFifo->discard(numSamples);
+    return true;
+}
+
+void Beamformer::setAudioLoad(float load) {
+    audioLoad = load;
+}
+
+void Beamformer::setProfiler(StageProfiler *p) {
+    profiler = p;
+}
+
+void Beamformer::setTraceRecorder(TraceRecorder *r) {
+    traceRecorder = r;
+}
+
+TraceRecorder *Beamformer::getTraceRecorder() const {
+    return traceRecorder;
+}
+
+float Beamformer::getDoaCpuBudget() const {
+    /** Full budget up to doaAudioLoadThreshold, then linearly down to zero at full audio load */
+    const float headroom = jlimit(0.f, 1.f, (1 - audioLoad) / (1 - doaAudioLoadThreshold));
+    return settings.doaCpuBudget * headroom;
 }
 
 void Beamformer::getBeams(AudioBuffer<float> &outBuffer) {
@@ -260,12 +834,25 @@ void Beamformer::getBeams(AudioBuffer<float> &outBuffer) {
     }
 }
 
-void Beamformer::setDoaEnergy(const Mtx &energy) {
-    GenericScopedLock<SpinLock> lock(doaLock);
-    doaLevels = energy;
+void Beamformer::setDoaEnergy(const Mtx &energy, const std::vector<DoaPeak> &peaks) {
+    /** Same sizes as the preallocated buffers, hence no allocation */
+    DoaMap &map = doaMaps.getWriteBuffer();
+    map.levels = energy;
+    map.peaks.assign(peaks.begin(), peaks.end());
+    doaMaps.publish();
+}
+
+void Beamformer::getDoaMap(Mtx &outDoaLevels, std::vector<DoaPeak> &peaks) const {
+    doaMaps.update();
+    const DoaMap &map = doaMaps.getReadBuffer();
+    outDoaLevels = map.levels;
+    peaks.assign(map.peaks.begin(), map.peaks.end());
+}
+
+void Beamformer::setDoaUpdateTime(float seconds) {
+    doaUpdateTime = seconds;
 }
 
-void Beamformer::getDoaEnergy(Mtx &outDoaLevels) const {
-    GenericScopedLock<SpinLock> lock(doaLock);
-    outDoaLevels = doaLevels;
+float Beamformer::getDoaUpdateTime() const {
+    return doaUpdateTime;
 }
@@ -10,15 +10,88 @@
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "ebeamerDefs.h"
 #include "AudioBufferFFT.h"
+#include "AudioBufferFifo.h"
 #include "BeamformingAlgorithms.h"
+#include "Profiling.h"
+#include "TraceRecorder.h"
+#include "TripleBuffer.h"
 
 
 
+// ==============================================================================
+
+/** Deployment-specific settings of the Beamformer, chosen at construction time */
+struct BeamformerSettings {
+    /** Number of threads evaluating the directions of arrival. 0 for automatic. */
+    int doaNumThreads = 0;
+
+    /** Number of threads rendering the beams, audio thread included. 0 for automatic, multi-threaded above 64 microphones. */
+    int renderNumThreads = 0;
+
+    /** Step of the coarse DOA grid [directions]. 1 evaluates every direction. */
+    int doaCoarseStep = 1;
+
+    /** Number of DOA energy peaks refined at full grid resolution */
+    int doaNumPeaks = 2;
+
+    /** Number of directions of arrival, horizontal axis */
+    int doaGridX = 25;
+
+    /** Number of directions of arrival, vertical axis. Linear arrays use a single row. */
+    int doaGridY = 9;
+
+    /** Fraction of real time the DOA thread may spend evaluating directions. Exceeding it lowers the update rate. */
+    float doaCpuBudget = 0.25f;
+
+    /** Estimate the directions of arrival. Offline rendering only needs the beams. */
+    bool doaEnabled = true;
+
+    /** Instances with the same array ID share the input spectra and the DOA. Empty to disable. */
+    String arrayId;
+
+    /** Microphone positions file, see ArrayGeometry::loadFromFile. Empty for the regular grid of eSticks. */
+    String geometryFile;
+
+    /** Closest focal distance of the beams [m]. 0 to steer the beams in the far field only. */
+    float nearfieldMinDistance = 0;
+
+    bool operator!=(const BeamformerSettings &rhs) const {
+        return doaNumThreads != rhs.doaNumThreads ||
+               renderNumThreads != rhs.renderNumThreads ||
+               doaCpuBudget != rhs.doaCpuBudget ||
+               doaGridX != rhs.doaGridX ||
+               doaGridY != rhs.doaGridY ||
+               doaCoarseStep != rhs.doaCoarseStep ||
+               doaNumPeaks != rhs.doaNumPeaks ||
+               doaEnabled != rhs.doaEnabled ||
+               arrayId != rhs.arrayId ||
+               geometryFile != rhs.geometryFile ||
+               nearfieldMinDistance != rhs.nearfieldMinDistance;
+    };
+};
+
+/** Peak of the DOA energy map */
+typedef struct {
+    /** Direction of the peak, x axis, with sub-grid resolution. Same convention as BeamParameters */
+    float doaX;
+    /** Direction of the peak, y axis, with sub-grid resolution. Same convention as BeamParameters */
+    float doaY;
+    /** Energy of the peak [dB] */
+    float energy;
+} DoaPeak;
+
 // ==============================================================================
 
 class Beamformer;
 
+class SharedInputAnalysis;
+
 /** Thread that computes periodically the Direction of Arrival of sound
+
+ Directions are evaluated in frequency domain, on the band of the DOA input only, with a delay-and-sum beamformer
+ whose steering vectors are separable along the two axes of the array: the microphones of each row are first
+ summed for each horizontal direction, the rows are then summed for each vertical direction.
+ Steering tables hence grow with numDoaHor + numDoaVer, not with their product.
  */
 class BeamformerDoa : public Thread {
 public:
@@ -28,15 +101,47 @@ public:
                   int numDoaVer_,
                   float sampleRate_,
                   int numActiveInputChannels,
-                  int firLen,
+                  int frameLen,
+                  float minFreq,
+                  float maxFreq,
+                  int numThreads_,
+                  int coarseStep_,
+                  int numPeaks_,
                   std::shared_ptr<dsp::FFT> fft_);
 
     ~BeamformerDoa();
 
     void run() override;
 
+    /** Flag new input as ready for the DOA thread, which polls the flag. Lock-free, for the audio thread at every block. */
+    void notifyInputReady();
+
 private:
 
+    /** Adapt frameStride to the CPU budget given the busy time over an update period [s] */
+    void adaptFrameStride(double busyTime, double updatePeriod);
+
+    /** Evaluate the energy of the selected directions for the current inputSpectra, sharding them across threads */
+    void evaluateAllDirections();
+
+    /** Split [0, numItems) in a contiguous range per thread and call fn(threadIdx, first, end) on each of them */
+    void runSharded(int numItems, const std::function<void(int, int, int)> &fn);
+
+    /** Sum the microphones of each row for horsToEvaluate[firstPos, endPos) */
+    void beamformRows(int firstPos, int endPos);
+
+    /** Accumulate the energy of dirsToEvaluate[firstPos, endPos) using the scratch buffers of threadIdx */
+    void evaluateDirections(int threadIdx, int firstPos, int endPos);
+
+    /** Select the directions to evaluate during the next update period: the coarse grid plus the peaks' surroundings */
+    void selectDirections();
+
+    /** Fill the levels of the directions not evaluated by interpolating the coarse grid */
+    void interpolateLevels();
+
+    /** Find the highest local maxima of the levels, with sub-grid resolution */
+    void findPeaks();
+
     /** Reference to the Beamformer */
     Beamformer &beamformer;
 
@@ -46,23 +151,100 @@ private:
     /** Number of directions of arrival, vertical axis */
     int numDoaVer;
 
-    /** Sampling frequency [Hz] */
+    /** Sampling frequency of the decimated DOA input [Hz] */
     float sampleRate;
 
     /** FFT */
     std::shared_ptr<dsp::FFT> fft;
 
+    /** Frame of DOA-filtered input samples, owned by the DOA thread */
+    AudioBuffer<float> doaFrame;
+
+    /** Set by notifyInputReady, cleared by the DOA thread before reading the input */
+    std::atomic<bool> wakeupPending{false};
+
+    /** Period the DOA thread polls wakeupPending with while idle [ms]. Short compared to a DOA update */
+    const int wakeupPollMs = 5;
+
+    /** One frame out of frameStride is evaluated, the others are discarded. Lengthens the update period as well. */
+    int frameStride = 1;
+    const int maxFrameStride = 16;
+
+    /** Hysteresis on the CPU budget before reducing frameStride */
+    const float strideDecreaseMargin = 0.8f;
+
     /** Inputs' buffer */
     AudioBufferFFT inputBuffer;
 
-    /** Convolution buffer */
-    AudioBufferFFT convolutionBuffer;
+    /** First frequency bin and number of bins in the DOA band */
+    int minBin, numBins;
+
+    /** In-band spectra of the inputs, one column per microphone */
+    CpxMtx inputSpectra;
+
+    /** Steering vectors of a row of microphones, numBins x numMicPerRow, one per horizontal direction */
+    std::vector<CpxMtx> steeringHor;
+
+    /** Steering vectors across rows, numBins x numRows, one per vertical direction */
+    std::vector<CpxMtx> steeringVer;
+
+    /** Rows summed towards each horizontal direction, numBins x numRows */
+    std::vector<CpxMtx> rowBeams;
+
+    /** Number of threads evaluating directions, including the DOA thread itself */
+    int numThreads = 1;
+
+    /** Worker threads, evaluating all the shards but the first one */
+    std::unique_ptr<ThreadPool> workers;
 
-    /** FIR filters for DOA estimation */
-    std::vector<AudioBufferFFT> doaFirFFT;
+    /** Number of shards still being evaluated by the workers */
+    std::atomic<int> numPendingShards{0};
 
-    /** DOA beam */
-    AudioBuffer<float> doaBeam;
+    /** Signaled by the worker evaluating the last shard */
+    WaitableEvent shardsDone;
+
+    /** Step of the coarse grid [directions] */
+    int coarseStep = 1;
+
+    /** Coarse grid indexes on each axis, including the last direction */
+    std::vector<int> coarseHor, coarseVer;
+
+    /** For each direction on each axis, the closest coarse indexes below and above */
+    std::vector<int> coarseHorLow, coarseHorHigh, coarseVerLow, coarseVerHigh;
+
+    /** Directions evaluated during the current update period, as linear indexes vDirIdx * numDoaHor + hDirIdx */
+    std::vector<int> dirsToEvaluate;
+
+    /** Directions evaluated during the current update period, as flags */
+    std::vector<bool> dirIsEvaluated;
+
+    /** Horizontal directions of dirsToEvaluate, whose rowBeams are needed */
+    std::vector<int> horsToEvaluate;
+
+    /** Number of peaks to refine */
+    int numPeaks = 1;
+
+    /** Local maxima found in the levels, as (level, direction index) */
+    std::vector<std::pair<float, int>> peakCandidates;
+
+    /** Peaks of the last update and their direction index */
+    std::vector<DoaPeak> peaks;
+    std::vector<int> peakDirIdxs;
+
+    /** Beam spectrum scratch buffer, one per thread */
+    std::vector<CpxVec> beamSpectra;
+
+    /** Energy accumulated by each direction during the current update period */
+    Mtx doaEnergy;
+
+    /** Number of input samples accumulated during the current update period */
+    int numAccumulatedSamples;
+
+    /** Number of input samples per update period, before frameStride */
+    int numSamplesPerUpdate;
+
+    /** Number of input samples read during the current update period, evaluated or discarded */
+    int numElapsedSamples;
 
     /** DOA levels [dB] */
     Mtx doaLevels;
@@ -73,6 +255,34 @@ private:
 
 // ==============================================================================
 
+/** Thread rendering a shard of the microphones into the beams, woken up by the audio thread at every block */
+class BeamformerRenderWorker : public Thread {
+
+public:
+
+    BeamformerRenderWorker(Beamformer &b, int shardIdx);
+
+    ~BeamformerRenderWorker();
+
+    void run() override;
+
+    /** Start rendering the shard of the current block */
+    void notifyBlockReady();
+
+private:
+
+    Beamformer &beamformer;
+
+    int shardIdx;
+
+    WaitableEvent blockReady;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (BeamformerRenderWorker);
+
+};
+
+// ==============================================================================
+
 class Beamformer {
 
 public:
@@ -80,17 +290,28 @@ public:
 
     /** Initialize the Beamformer with a set of static parameters.
      @param numBeams: number of beams the beamformer has to compute
-     @param mic: microphone configuration
+     @param layout: eSticks layout
      @param sampleRate:
      @param maximumExpectedSamplesPerBlock: 
+     @param settings: deployment-specific settings
      */
-    Beamformer(int numBeams, MicConfig mic, double sampleRate, int maximumExpectedSamplesPerBlock);
+    Beamformer(int numBeams, const ArrayLayout &layout, double sampleRate, int maximumExpectedSamplesPerBlock,
+               const BeamformerSettings &settings = {});
 
     /** Destructor. */
     ~Beamformer();
     
-    /** Get microphone configuration */
-    MicConfig getMicConfig() const;
+    /** Get eSticks layout */
+    ArrayLayout getArrayLayout() const;
+
+    /** Length of the beam FIR filters, hence number of past input samples a beam depends on */
+    int getFirLen() const;
+
+    /** Number of microphones processed */
+    int getNumMics() const;
+
+    /** Size of the FFT of the input spectra and of the beams */
+    int getFftSize() const;
 
     /** Process a new block of samples.
      
@@ -104,8 +325,12 @@ public:
      */
     void getBeams(AudioBuffer<float> &outBuffer);
 
-    /** Set the parameters for a specific beam  */
-    void setBeamParameters(int beamIdx, const BeamParameters &beamParams);
+    /** Set the parameters for a specific beam
+     
+     @param smooth: move the FIR towards the new parameters with the update time constant, as a moving beam does.
+                    false to switch immediately.
+     */
+    void setBeamParameters(int beamIdx, const BeamParameters &beamParams, bool smooth = true);
 
     /** Get FIR in time domain for a given direction of arrival
     
@@ -115,14 +340,81 @@ public:
     */
     void getFir(AudioBuffer<float> &fir, const BeamParameters &params, float alpha = 1) const;
 
-    /** Copy the estimated energy contribution from the directions of arrival */
-    void getDoaEnergy(Mtx &energy) const;
+    /** Design the FIR of a beam in frequency domain, ready to be passed to setBeamFir. Thread safe. */
+    void getFirFFT(AudioBufferFFT &firFFT, const BeamParameters &params) const;
+
+    /** Set the FIR of a beam, as designed by getFirFFT. No design work is done, the FIR is only copied. */
+    void setBeamFir(int beamIdx, const AudioBufferFFT &fir);
+
+    /** Copy the latest DOA map: the estimated energy contribution from the directions of arrival and its peaks,
+     the highest first. Both come from the same DOA update.
+     
+     Lock-free, and allocation-free if energy already has the grid size. To be called from a single thread, once per consumer tick.
+     */
+    void getDoaMap(Mtx &energy, std::vector<DoaPeak> &peaks) const;
+
+    /** Publish the estimated energy contribution from the directions of arrival and its peaks. DOA thread only. */
+    void setDoaEnergy(const Mtx &energy, const std::vector<DoaPeak> &peaks);
+
+    /** Set the processing time of the last DOA update [s] */
+    void setDoaUpdateTime(float seconds);
+
+    /** Get the processing time of the last DOA update [s] */
+    float getDoaUpdateTime() const;
+
+    /** Get the separable steering vectors for DOA estimation, designed for the decimated DOA input
+     
+     @see DAS::FarfieldURA::getSteeringVectors
+     */
+    void getDoaSteeringVectors(CpxMtx &steeringX, CpxMtx &steeringY, const BeamParameters &params,
+                               const Vec &freqs) const;
+
+    /** Read the next frame of band-passed and decimated DOA input
+     
+     To be called only by the DOA thread, the single consumer of the DOA input FIFO.
+     @param frame: buffer with numChannels >= number of microphones, filled with frame.getNumSamples() samples
+     @return: false if not enough samples are available yet
+     */
+    bool getDoaInputFrame(AudioBuffer<float> &frame);
+
+    /** Discard the next frame of DOA input. Same as getDoaInputFrame, without copying the samples. */
+    bool discardDoaInputFrame(int numSamples);
+
+    /** Set the measured load of the audio thread, 1 meaning the whole block period */
+    void setAudioLoad(float load);
+
+    /** Set the profiler timing the stages of processBlock and setBeamParameters. nullptr to disable. */
+    void setProfiler(StageProfiler *p);
+
+    /** Set the trace recorder for the audio and DOA threads. nullptr to disable. */
+    void setTraceRecorder(TraceRecorder *r);
+
+    /** Trace recorder, nullptr if disabled */
+    TraceRecorder *getTraceRecorder() const;
 
-    /** Set the estimated energy contribution from the directions of arrival */
-    void setDoaEnergy(const Mtx &energy);
+    /** Fraction of real time the DOA thread may use now, lowered as the audio thread load rises */
+    float getDoaCpuBudget() const;
 
-    /** Get last doa filtered input buffer */
-    void getDoaInputBuffer(AudioBufferFFT &dst) const;
+    /** Accumulate the spectra of the microphones of a shard of the current block, convolved with the FIR of each beam.
+     
+     Called by the audio thread for the first shard and by the render workers for the other ones.
+     A worker that is late renders a block the audio thread has given up on, and its result is discarded.
+     */
+    void renderShard(int shardIdx);
+
+    /** Share the input spectra and the DOA with the other members of group. nullptr to stop sharing.
+     
+     Message thread only, while processBlock is not running. The Beamformer must have joined group already.
+     The DOA thread is started unless another member of group feeds the shared DOA.
+     @return: false if the spectra of group have another size, in which case nothing is shared
+     */
+    bool setSharedInput(SharedInputAnalysis *group);
+
+    /** Start the DOA thread, if enabled and not running yet. Message thread only, processBlock may be running.
+     
+     Called at construction when the input is not meant to be shared, otherwise as the Beamformer becomes the leader of its group.
+     */
+    void startDoa();
 
 
 private:
@@ -147,6 +439,9 @@ private:
     /** Number of beams */
     int numBeams;
 
+    /** Deployment-specific settings */
+    BeamformerSettings settings;
+
     /** Number of directions of arrival */
     int numDoaHor;
     int numDoaVer;
@@ -154,6 +449,16 @@ private:
     /** Beamforming algorithm */
     std::unique_ptr<BeamformingAlgorithm> alg;
 
+    /** Beamforming algorithm for DOA estimation, at the decimated sample rate */
+    std::unique_ptr<DAS::FarfieldURA> doaAlg;
+
+    /** Refinement of the DOA grid for the delay tables of arbitrary geometries */
+    const int geometryTableRefinement = 4;
+
+    /** Refinement of the DOA grid and number of distances for the focal point tables of near-field beams */
+    const int nearfieldTableRefinement = 2;
+    const int nearfieldTableDistances = 16;
+
     /** FIR filters length. Diepends on the algorithm */
     int firLen;
 
@@ -167,8 +472,32 @@ private:
     /** Inputs' buffer */
     AudioBufferFFT inputBuffer;
 
-    /** Convolution buffer */
-    AudioBufferFFT convolutionBuffer;
+    /** Number of shards the microphones are split into, one per render thread */
+    int numRenderShards = 1;
+
+    /** Beam spectra accumulated by each shard, a channel per beam */
+    std::vector<AudioBufferFFT> shardSpectra;
+
+    /** Render workers, rendering all the shards but the first one */
+    std::vector<std::unique_ptr<BeamformerRenderWorker>> renderWorkers;
+
+    /** Index of the block being rendered, published to the workers after renderSpectra */
+    std::atomic<int64> renderBlockIdx{0};
+
+    /** Index of the last block whose shard is complete in shardSpectra, one per shard */
+    std::unique_ptr<std::atomic<int64>[]> shardDoneBlockIdx;
+
+    /** Beam spectra of a shard rendered by the audio thread in place of a late worker */
+    AudioBufferFFT lateShardSpectra;
+
+    /** Shortest time the audio thread spins for the workers before rendering their shards itself [s] */
+    const double renderSpinMinSeconds = 100e-6;
+
+    /** Input spectra of the block being rendered */
+    std::atomic<const AudioBufferFFT *> renderSpectra{nullptr};
+
+    /** Convolve the microphones of a shard with the FIR of each beam and sum them into beamSpectra */
+    void convolveShard(int shardIdx, const AudioBufferFFT &spectra, AudioBufferFFT &beamSpectra);
 
     /** Beams' outputs buffer */
     AudioBuffer<float> beamBuffer;
@@ -178,8 +507,8 @@ private:
     /** FIR coefficients update alpha */
     float alpha = 1;
 
-    /** Microphones configuration */
-    MicConfig micConfig = ULA_1ESTICK;
+    /** eSticks layout */
+    ArrayLayout arrayLayout = {1, 1};
 
     /** Initialize the beamforming algorithm */
     void initAlg();
@@ -187,25 +516,82 @@ private:
     /** DOA thread */
     std::unique_ptr<BeamformerDoa> doaThread;
 
+    /** DOA thread, published to the audio thread once started. nullptr while the DOA is fed by another member of the group */
+    std::atomic<BeamformerDoa *> activeDoaThread{nullptr};
+
+    /** Sampling frequency of the decimated DOA input [Hz] */
+    float doaSampleRate;
+
+    /** FFT of the DOA frames */
+    std::shared_ptr<juce::dsp::FFT> doaFft;
+
     /**DOA update requency [Hz] */
     const float doaUpdateFrequency = 10;
 
-    /** DOA levels [dB] */
-    Mtx doaLevels;
+    /** A DOA map with its peaks */
+    typedef struct {
+        /** DOA levels [dB] */
+        Mtx levels;
+        /** DOA peaks */
+        std::vector<DoaPeak> peaks;
+    } DoaMap;
+
+    /** DOA maps, published by the DOA thread and read by the GUI. Preallocated. */
+    mutable TripleBuffer<DoaMap> doaMaps;
 
-    /** DOA Band pass Filters */
+    /** DOA Band pass Filters, doaBPNumStages per microphone */
     std::vector<IIRFilter> doaBPFilters;
     const float doaBPfreq = 2000;
     const float doaBPQ = 1;
+    const int doaBPNumStages = 2;
+
+    /** DOA anti-aliasing Butterworth low pass, doaLPNumStages second order sections per microphone.
+     Just above the DOA band, whose upper edge is 2 * doaBPfreq.
+     */
+    std::vector<IIRFilter> doaLPFilters;
+    const float doaLPfreq = 2.2f * doaBPfreq;
+    const int doaLPNumStages = 3;
 
-    /** inputBuffer lock */
-    SpinLock doaInputBufferLock;
+    /** Minimum sample rate of the decimated DOA input [Hz]. Frequencies aliasing onto the DOA band are then
+     at least twice its upper edge, in the stop band of the low pass.
+     */
+    const float doaMinSampleRate = 6 * doaBPfreq;
+
+    /** DOA input decimation factor */
+    int doaDecimation = 1;
 
-    /** Input buffer with DOA-filtered input signal */
+    /** Input samples elapsed since the last decimated sample, modulo doaDecimation */
+    int doaDecimationPhase = 0;
+
+    /** Scratch buffer with DOA-filtered input signal, audio thread only */
     AudioBuffer<float> doaInputBuffer;
 
-    /** DOA Lock */
-    SpinLock doaLock;
+    /** Scratch buffer with decimated DOA-filtered input signal, audio thread only */
+    AudioBuffer<float> doaDecimatedBuffer;
+
+    /** Lock-free FIFO from the audio thread to the DOA thread. Allocated by startDoa */
+    std::unique_ptr<AudioBufferFifo> doaInputFifo;
+
+    /** DOA frame length [samples]. The DOA thread is woken up once at least a frame is ready */
+    int doaFrameLen;
+
+    /** Measured load of the audio thread */
+    std::atomic<float> audioLoad{0};
+
+    /** Hot-path profiler, owned by the caller */
+    StageProfiler *profiler = nullptr;
+
+    /** Trace recorder, owned by the caller. Read by the DOA thread too */
+    std::atomic<TraceRecorder *> traceRecorder{nullptr};
+
+    /** Audio thread load above which the DOA CPU budget is reduced, down to zero at full load */
+    const float doaAudioLoadThreshold = 0.5f;
+
+    /** Processing time of the last DOA update [s] */
+    std::atomic<float> doaUpdateTime{0};
+
+    /** Input analysis shared with other instances, owned by the caller. nullptr if not shared */
+    SharedInputAnalysis *sharedInput = nullptr;
 
 
 };
@@ -94,5 +94,225 @@ namespace DAS {
 
     }
 
+    void FarfieldURA::getSteeringVectors(CpxMtx &steeringX, CpxMtx &steeringY, const BeamParameters &params,
+                                         const Vec &freqs) const {
+
+        /** Delay between adjacent microphones [s], same as getFir */
+        const float deltaX = sin(params.doaX * pi / 2) * micDistX / soundspeed;
+        const float deltaY = sin(params.doaY * pi / 2) * micDistY / soundspeed;
+        /** Delays of the microphones of a row and of the rows [s] */
+        const Vec micDelaysX = deltaX * Vec::LinSpaced(numMicPerRow, 0, numMicPerRow - 1);
+        const Vec micDelaysY = deltaY * Vec::LinSpaced(numRows, 0, numRows - 1);
+
+        steeringX = (-j2pi * freqs * micDelaysX.transpose()).array().exp() * (referencePower / numMic);
+        steeringY = (-j2pi * freqs * micDelaysY.transpose()).array().exp();
+
+    }
+
+    /** Unit vector pointing towards a far-field direction, see ArrayGeometry for the axes */
+    static Vec getDirection(float doaX, float doaY) {
+        Vec direction(3);
+        direction(0) = sin(doaX * pi / 2);
+        direction(1) = sin(doaY * pi / 2);
+        direction(2) = sqrt(jmax(0.f, 1 - direction(0) * direction(0) - direction(1) * direction(1)));
+        return direction;
+    }
+
+    FarfieldGeometry::FarfieldGeometry(const ArrayGeometry &geometry, float fs_, float soundspeed_,
+                                       int tableSizeX_, int tableSizeY_) {
+
+        numMic = geometry.getNumMics();
+        fs = fs_;
+        soundspeed = soundspeed_;
+        tableSizeX = jmax(2, tableSizeX_);
+        tableSizeY = jmax(2, tableSizeY_);
+
+        commonDelay = 64;
+        firLen = geometry.getAperture() / soundspeed * fs + commonDelay;
+
+        fft = std::make_unique<juce::dsp::FFT>(ceil(log2(firLen)));
+
+        win.resize(fft->getSize());
+        designTukeyWindow(win, fft->getSize(), commonDelay / 2);
+
+        freqAxes = Vec::LinSpaced(fft->getSize(), 0, fs * (fft->getSize() - 1) / fft->getSize());
+
+        /** A microphone closer to the source receives the wavefront earlier, hence it is delayed more */
+        const Mtx &positions = geometry.getPositions();
+        delayTable.resize(numMic, tableSizeX * tableSizeY);
+        for (auto yIdx = 0; yIdx < tableSizeY; yIdx++) {
+            for (auto xIdx = 0; xIdx < tableSizeX; xIdx++) {
+                const float doaX = -1 + 2.f * xIdx / (tableSizeX - 1);
+                const float doaY = -1 + 2.f * yIdx / (tableSizeY - 1);
+                Vec delays = positions * getDirection(doaX, doaY) / soundspeed;
+                delays.array() -= delays.minCoeff();
+                delayTable.col(yIdx * tableSizeX + xIdx) = delays;
+            }
+        }
+
+        const Vec center = geometry.getCenter();
+        offsetX = (positions.col(0).array() - center(0)).abs();
+        offsetY = (positions.col(1).array() - center(1)).abs();
+    }
+
+    int FarfieldGeometry::getFirLen() const {
+        return firLen;
+    }
+
+    void FarfieldGeometry::getDelays(Vec &delays, const BeamParameters &params) const {
+        const float posX = (jlimit(-1.f, 1.f, params.doaX) + 1) / 2 * (tableSizeX - 1);
+        const float posY = (jlimit(-1.f, 1.f, params.doaY) + 1) / 2 * (tableSizeY - 1);
+        const int xIdx = jmin((int) posX, tableSizeX - 2);
+        const int yIdx = jmin((int) posY, tableSizeY - 2);
+        const float fracX = posX - xIdx;
+        const float fracY = posY - yIdx;
+        const int col = yIdx * tableSizeX + xIdx;
+        delays = (1 - fracY) * ((1 - fracX) * delayTable.col(col) + fracX * delayTable.col(col + 1)) +
+                 fracY * ((1 - fracX) * delayTable.col(col + tableSizeX) + fracX * delayTable.col(col + tableSizeX + 1));
+    }
+
+    /** Mask of the microphones active with a given width. Along each axis, the microphones closest to the center are always active */
+    static Vec getWidthMask(const Vec &offsetX, const Vec &offsetY, float width) {
+        const float maxOffsetX = jmax(offsetX.maxCoeff() * (1 - width), offsetX.minCoeff()) + 1e-4f;
+        const float maxOffsetY = jmax(offsetY.maxCoeff() * (1 - width), offsetY.minCoeff()) + 1e-4f;
+        return ((offsetX.array() <= maxOffsetX) && (offsetY.array() <= maxOffsetY)).cast<float>();
+    }
+
+    void FarfieldGeometry::getGains(Vec &gains, float width) const {
+        gains = getWidthMask(offsetX, offsetY, width);
+        gains *= referencePower / gains.sum();
+    }
+
+    void FarfieldGeometry::getFir(AudioBuffer<float> &fir, const BeamParameters &params, float alpha) const {
+
+        Vec micDelays;
+        getDelays(micDelays, params);
+        micDelays.array() += commonDelay / fs;
+
+        Vec micGains;
+        getGains(micGains, params.width);
+
+        /** Compute the fractional delays in frequency domain and apply the gain */
+        CpxMtx irFFT = (-j2pi * freqAxes * micDelays.transpose()).array().exp();
+        irFFT = irFFT.cwiseProduct(micGains.transpose().replicate(freqAxes.size(), 1));
+
+        /** Convert  from requency to time domain and add to destination*/
+        for (auto micIdx = 0; micIdx < jmin(numMic, fir.getNumChannels()); micIdx++) {
+            freqToTime(fir, micIdx, irFFT.col(micIdx), fft.get(), win, alpha);
+        }
+        /** Clear the remaining FIR, if any */
+        for (auto micIdx = jmin(numMic, fir.getNumChannels()); micIdx < fir.getNumChannels(); micIdx++) {
+            fir.clear(micIdx, 0, fir.getNumSamples());
+        }
+
+    }
+
+
+    NearfieldGeometry::NearfieldGeometry(const ArrayGeometry &geometry, float fs_, float soundspeed_,
+                                         float minDistance_, int tableSizeX_, int tableSizeY_,
+                                         int tableSizeDistance_) {
+
+        numMic = geometry.getNumMics();
+        fs = fs_;
+        soundspeed = soundspeed_;
+        minDistance = minDistance_;
+        tableSizeX = jmax(2, tableSizeX_);
+        tableSizeY = jmax(2, tableSizeY_);
+        tableSizeDistance = jmax(2, tableSizeDistance_);
+
+        /** Differences of distance from a focal point are bounded by the aperture, as far-field delays are */
+        commonDelay = 64;
+        firLen = geometry.getAperture() / soundspeed * fs + commonDelay;
+
+        fft = std::make_unique<juce::dsp::FFT>(ceil(log2(firLen)));
+
+        win.resize(fft->getSize());
+        designTukeyWindow(win, fft->getSize(), commonDelay / 2);
+
+        freqAxes = Vec::LinSpaced(fft->getSize(), 0, fs * (fft->getSize() - 1) / fft->getSize());
+
+        const Mtx &positions = geometry.getPositions();
+        const Vec center = geometry.getCenter();
+        const int numPoints = tableSizeX * tableSizeY * tableSizeDistance;
+        delayTable.resize(numMic, numPoints);
+        gainTable.resize(numMic, numPoints);
+        for (auto distIdx = 0; distIdx < tableSizeDistance; distIdx++) {
+            const float invDistance = distIdx / (minDistance * (tableSizeDistance - 1));
+            for (auto yIdx = 0; yIdx < tableSizeY; yIdx++) {
+                for (auto xIdx = 0; xIdx < tableSizeX; xIdx++) {
+                    const Vec direction = getDirection(-1 + 2.f * xIdx / (tableSizeX - 1),
+                                                       -1 + 2.f * yIdx / (tableSizeY - 1));
+                    Vec delays, gains;
+                    if (distIdx == 0) {
+                        delays = positions * direction / soundspeed;
+                        gains = Vec::Ones(numMic);
+                    } else {
+                        /** A microphone closer to the focal point receives the wavefront earlier, hence it is delayed more */
+                        const float distance = 1 / invDistance;
+                        const Vec focus = center + distance * direction;
+                        const Vec micDistances = (positions.rowwise() - focus.transpose()).rowwise().norm();
+                        delays = (distance - micDistances.array()) / soundspeed;
+                        gains = micDistances / distance;
+                    }
+                    delays.array() -= delays.minCoeff();
+                    const int col = (distIdx * tableSizeY + yIdx) * tableSizeX + xIdx;
+                    delayTable.col(col) = delays;
+                    gainTable.col(col) = gains;
+                }
+            }
+        }
+
+        offsetX = (positions.col(0).array() - center(0)).abs();
+        offsetY = (positions.col(1).array() - center(1)).abs();
+    }
+
+    int NearfieldGeometry::getFirLen() const {
+        return firLen;
+    }
+
+    void NearfieldGeometry::getFir(AudioBuffer<float> &fir, const BeamParameters &params, float alpha) const {
+
+        /** Position of the focal point within the tables */
+        const float posX = (jlimit(-1.f, 1.f, params.doaX) + 1) / 2 * (tableSizeX - 1);
+        const float posY = (jlimit(-1.f, 1.f, params.doaY) + 1) / 2 * (tableSizeY - 1);
+        const float invDistance = params.distance > 0 ? 1 / jmax(minDistance, params.distance) : 0;
+        const float posDist = invDistance * minDistance * (tableSizeDistance - 1);
+        const int xIdx = jmin((int) posX, tableSizeX - 2);
+        const int yIdx = jmin((int) posY, tableSizeY - 2);
+        const int distIdx = jmin((int) posDist, tableSizeDistance - 2);
+        const float fracX = posX - xIdx;
+        const float fracY = posY - yIdx;
+        const float fracDist = posDist - distIdx;
+
+        /** Trilinear interpolation of delays and gains */
+        Vec micDelays = Vec::Zero(numMic);
+        Vec micGains = Vec::Zero(numMic);
+        for (auto corner = 0; corner < 8; corner++) {
+            const int dx = corner & 1, dy = (corner >> 1) & 1, dd = (corner >> 2) & 1;
+            const float weight = (dx ? fracX : 1 - fracX) * (dy ? fracY : 1 - fracY) * (dd ? fracDist : 1 - fracDist);
+            const int col = ((distIdx + dd) * tableSizeY + yIdx + dy) * tableSizeX + xIdx + dx;
+            micDelays += weight * delayTable.col(col);
+            micGains += weight * gainTable.col(col);
+        }
+        micDelays.array() += commonDelay / fs;
+
+        /** Apply the width and normalize the power */
+        micGains = micGains.cwiseProduct(getWidthMask(offsetX, offsetY, params.width));
+        micGains *= referencePower / micGains.sum();
+
+        /** Compute the fractional delays in frequency domain and apply the gain */
+        CpxMtx irFFT = (-j2pi * freqAxes * micDelays.transpose()).array().exp();
+        irFFT = irFFT.cwiseProduct(micGains.transpose().replicate(freqAxes.size(), 1));
+
+        /** Convert  from requency to time domain and add to destination*/
+        for (auto micIdx = 0; micIdx < jmin(numMic, fir.getNumChannels()); micIdx++) {
+            freqToTime(fir, micIdx, irFFT.col(micIdx), fft.get(), win, alpha);
+        }
+        /** Clear the remaining FIR, if any */
+        for (auto micIdx = jmin(numMic, fir.getNumChannels()); micIdx < fir.getNumChannels(); micIdx++) {
+            fir.clear(micIdx, 0, fir.getNumSamples());
+        }
+
+    }
 
 }
@@ -9,7 +9,7 @@
 
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "SignalProcessing.h"
-#include "BeamformingAlgorithms.h"
+#include "ArrayGeometry.h"
 
 /** Beam parameters data structure for a Uniform Rectangular Array
     Convention used:
@@ -31,6 +31,10 @@ typedef struct {
      Range: 0 (the most focused) to 1 (the least focused)
      */
     float width;
+    /** Distance of the focal point from the center of the array [m], along the pointing direction.
+     0 for a far-field beam. Ignored by far-field algorithms.
+     */
+    float distance = 0;
 } BeamParameters;
 
 
@@ -87,6 +91,18 @@ namespace DAS {
          */
         void getFir(AudioBuffer<float> &fir, const BeamParameters &params, float alpha = 1) const override;
 
+        /** Get the steering vectors for a given direction of arrival, separable along the two axes
+         
+         The response of microphone (col, row) at each frequency is steeringX(:, col) * steeringY(:, row).
+         Delays are relative to the first microphone, the gain is the same as getFir with width 0.
+         @param steeringX: output, freqs.size() x number of microphones per row
+         @param steeringY: output, freqs.size() x number of rows
+         @param params: beam parameters, width is ignored
+         @param freqs: frequencies [Hz]
+         */
+        void getSteeringVectors(CpxMtx &steeringX, CpxMtx &steeringY, const BeamParameters &params,
+                                const Vec &freqs) const;
+
     private:
 
         /** Distance between microphones, X axes [m] */
@@ -130,4 +146,163 @@ namespace DAS {
 
     };
 
+/** Farfield Beamformer for arbitrary microphone positions
+ 
+ The steering delays of every microphone are computed once, on a grid of directions spanning the whole
+ doaX, doaY range. The FIR of a beam only interpolates them bilinearly, no geometry is involved.
+ The width mutes the microphones farthest from the center of the array, along each axis,
+ as FarfieldURA does on a regular grid.
+ */
+    class FarfieldGeometry : public BeamformingAlgorithm {
+
+    public:
+
+        /** Initialize the delay tables
+         
+         @param geometry: microphone positions
+         @param fs: sampling frequency [Hz]
+         @param soundspeed: sound speed [m/s]
+         @param tableSizeX: number of directions of the delay tables along doaX, at least 2
+         @param tableSizeY: number of directions of the delay tables along doaY, at least 2
+         */
+        FarfieldGeometry(const ArrayGeometry &geometry, float fs, float soundspeed, int tableSizeX, int tableSizeY);
+
+        /** Get the minimum FIR length for the given configuration [samples] */
+        int getFirLen() const override;
+
+        /** Get FIR in time domain for a given direction of arrival
+         
+         @param fir: an AudioBuffer object with numChannels >= number of microphones and numSamples >= firLen
+         @param params: beam parameters
+         @param alpha: exponential interpolation coefficient. 1 means complete override (instant update), 0 means no override (complete preservation)
+         */
+        void getFir(AudioBuffer<float> &fir, const BeamParameters &params, float alpha = 1) const override;
+
+    private:
+
+        /** Number of microphones */
+        int numMic;
+
+        /** Sampling frequency [Hz] */
+        float fs;
+
+        /** Soundspeed [m/s] */
+        float soundspeed;
+
+        /** Common delay applied to all the filters to make filters causal [samples] */
+        int commonDelay;
+
+        /** Length of FIR filters [samples] */
+        int firLen;
+
+        /** FFT object */
+        std::unique_ptr<juce::dsp::FFT> fft;
+
+        /** Window applied to the FIR filters in time domain */
+        Vec win;
+
+        /** Frequencies axes */
+        Vec freqAxes;
+
+        /** Size of the delay tables */
+        int tableSizeX, tableSizeY;
+
+        /** Steering delays [s], a column per direction doaYIdx * tableSizeX + doaXIdx. The smallest delay is 0 */
+        Mtx delayTable;
+
+        /** Distance of each microphone from the center of the array, along x and y [m] */
+        Vec offsetX, offsetY;
+
+        /** Reference power for normalization */
+        const float referencePower = 3;
+
+        /** Interpolate the steering delays of a direction [s] */
+        void getDelays(Vec &delays, const BeamParameters &params) const;
+
+        /** Mask of the microphones active with a given width, normalized in power */
+        void getGains(Vec &gains, float width) const;
+
+    };
+
+/** Nearfield Beamformer for arbitrary microphone positions, focused on a point
+ 
+ The focal point is at BeamParameters::distance from the center of the array, in the direction doaX, doaY.
+ Delays and gains of every microphone are computed once on a 3D grid of focal points: directions as in
+ FarfieldGeometry, and distances evenly spaced in 1 / distance from the far field down to minDistance,
+ where the wavefront curvature changes the fastest. Refocusing a beam interpolates them trilinearly.
+ Gains compensate the spherical spreading from the focal point to each microphone.
+ */
+    class NearfieldGeometry : public BeamformingAlgorithm {
+
+    public:
+
+        /** Initialize the delay and gain tables
+         
+         @param geometry: microphone positions
+         @param fs: sampling frequency [Hz]
+         @param soundspeed: sound speed [m/s]
+         @param minDistance: closest focal distance [m]. Closer focal points are moved to this distance
+         @param tableSizeX: number of directions of the tables along doaX, at least 2
+         @param tableSizeY: number of directions of the tables along doaY, at least 2
+         @param tableSizeDistance: number of distances of the tables, far field included, at least 2
+         */
+        NearfieldGeometry(const ArrayGeometry &geometry, float fs, float soundspeed, float minDistance,
+                          int tableSizeX, int tableSizeY, int tableSizeDistance);
+
+        /** Get the minimum FIR length for the given configuration [samples] */
+        int getFirLen() const override;
+
+        /** Get FIR in time domain for a given focal point
+         
+         @param fir: an AudioBuffer object with numChannels >= number of microphones and numSamples >= firLen
+         @param params: beam parameters
+         @param alpha: exponential interpolation coefficient. 1 means complete override (instant update), 0 means no override (complete preservation)
+         */
+        void getFir(AudioBuffer<float> &fir, const BeamParameters &params, float alpha = 1) const override;
+
+    private:
+
+        /** Number of microphones */
+        int numMic;
+
+        /** Sampling frequency [Hz] */
+        float fs;
+
+        /** Soundspeed [m/s] */
+        float soundspeed;
+
+        /** Closest focal distance [m] */
+        float minDistance;
+
+        /** Common delay applied to all the filters to make filters causal [samples] */
+        int commonDelay;
+
+        /** Length of FIR filters [samples] */
+        int firLen;
+
+        /** FFT object */
+        std::unique_ptr<juce::dsp::FFT> fft;
+
+        /** Window applied to the FIR filters in time domain */
+        Vec win;
+
+        /** Frequencies axes */
+        Vec freqAxes;
+
+        /** Size of the tables */
+        int tableSizeX, tableSizeY, tableSizeDistance;
+
+        /** Focusing delays [s] and gains, a column per focal point (distIdx * tableSizeY + doaYIdx) * tableSizeX + doaXIdx.
+         The smallest delay is 0.
+         */
+        Mtx delayTable, gainTable;
+
+        /** Distance of each microphone from the center of the array, along x and y [m] */
+        Vec offsetX, offsetY;
+
+        /** Reference power for normalization */
+        const float referencePower = 3;
+
+    };
+
 }
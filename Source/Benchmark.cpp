@@ -0,0 +1,220 @@
+/*
+ Headless Beamformer benchmark
+ 
+ Authors:
+ Luca Bondi (luca.bondi@polimi.it)
+*/
+
+#include "Benchmark.h"
+#include <iostream>
+
+#if JUCE_WINDOWS
+ #include <windows.h>
+ #include <psapi.h>
+ #pragma comment(lib, "psapi.lib")
+#elif JUCE_MAC || JUCE_LINUX
+ #include <sys/resource.h>
+#endif
+
+/** Parse a comma separated list of numbers */
+template<typename T>
+static std::vector<T> parseList(const String &s) {
+    std::vector<T> values;
+    for (const auto &token : StringArray::fromTokens(s, ",", "")) {
+        if (token.trim().isNotEmpty()) {
+            values.push_back(static_cast<T>(token.trim().getDoubleValue()));
+        }
+    }
+    return values;
+}
+
+BeamformerBenchmark::BeamformerBenchmark(const ArgumentList &args) {
+    
+    for (auto configIdx = 0; configIdx < micConfigLabels.size(); configIdx++) {
+        layouts.push_back(getArrayLayout(static_cast<MicConfig>(configIdx)));
+    }
+    for (const auto &layout : std::vector<ArrayLayout>({{6, 1}, {8, 1}, {3, 2}, {4, 2}, {2, 4}})) {
+        layouts.push_back(layout);
+    }
+    
+    if (args.containsOption("--sample-rates"))
+        sampleRates = parseList<double>(args.getValueForOption("--sample-rates"));
+    if (args.containsOption("--block-sizes"))
+        blockSizes = parseList<int>(args.getValueForOption("--block-sizes"));
+    if (args.containsOption("--beams"))
+        numBeams = parseList<int>(args.getValueForOption("--beams"));
+    if (args.containsOption("--configs")) {
+        layouts.clear();
+        for (const auto &token : StringArray::fromTokens(args.getValueForOption("--configs"), ",", "")) {
+            ArrayLayout layout;
+            if (parseArrayLayout(token, layout))
+                layouts.push_back(layout);
+        }
+    }
+    if (args.containsOption("--seconds"))
+        secondsPerConfig = jmax(0.1, args.getValueForOption("--seconds").getDoubleValue());
+    if (args.containsOption("--noise"))
+        noiseLevel = args.getValueForOption("--noise").getFloatValue();
+    if (args.containsOption("--rt60"))
+        rt60 = args.getValueForOption("--rt60").getFloatValue();
+    if (args.containsOption("--drr"))
+        directToReverbRatio = args.getValueForOption("--drr").getFloatValue();
+    if (args.containsOption("--output"))
+        outputFile = args.getFileForOption("--output");
+}
+
+int BeamformerBenchmark::run() {
+    
+    std::unique_ptr<OutputStream> out;
+    if (outputFile != File()) {
+        outputFile.deleteFile();
+        out = std::make_unique<FileOutputStream>(outputFile);
+        if (static_cast<FileOutputStream *>(out.get())->failedToOpen()) {
+            std::cerr << "Cannot open " << outputFile.getFullPathName() << std::endl;
+            return 1;
+        }
+    }
+    
+    for (const auto &layout : layouts) {
+        for (auto fs : sampleRates) {
+            for (auto blockSize : blockSizes) {
+                for (auto beams : numBeams) {
+                    const auto result = runConfig({layout, fs, blockSize, beams});
+                    const String line = JSON::toString(toVar(result), true);
+                    if (out != nullptr) {
+                        *out << line << newLine;
+                        out->flush();
+                    } else {
+                        std::cout << line << std::endl;
+                    }
+                }
+            }
+        }
+    }
+    
+    return 0;
+}
+
+BeamformerBenchmark::Result BeamformerBenchmark::runConfig(const Config &config) const {
+    
+    Beamformer beamformer(config.numBeams, config.layout, config.sampleRate, config.blockSize);
+    
+    /** Beams spread across the field of view, set at every block as the plugin does */
+    std::vector<BeamParameters> beamParams(config.numBeams);
+    for (auto beamIdx = 0; beamIdx < config.numBeams; beamIdx++) {
+        const float doaX = config.numBeams > 1 ? -0.8f + 1.6f * beamIdx / (config.numBeams - 1) : 0;
+        beamParams[beamIdx] = {doaX, 0, 0.2f};
+    }
+    
+    /** Simulated input: a white noise source in the direction of each beam, rendered once and looped */
+    const int numInputs = getNumMics(config.layout);
+    const int numBlocks = jmax(1, roundToInt(secondsPerConfig * config.sampleRate / config.blockSize));
+    const int numWarmupBlocks = roundToInt(warmupSeconds * config.sampleRate / config.blockSize);
+    const int numInputBlocks = jmax(16, roundToInt(inputSeconds * config.sampleRate / config.blockSize));
+    std::vector<ArraySimulator::Source> sources;
+    ArraySimulator simulator(config.layout, config.sampleRate, config.blockSize);
+    simulator.setNoiseLevel(noiseLevel);
+    simulator.setReverb(rt60, directToReverbRatio);
+    for (const auto &params : beamParams) {
+        sources.push_back({params.doaX, params.doaY, sourceLevel, 0});
+        simulator.addSource(sources.back());
+    }
+    AudioBuffer<float> input(numInputs, config.blockSize * numInputBlocks);
+    for (auto blockIdx = 0; blockIdx < numInputBlocks; blockIdx++) {
+        AudioBuffer<float> inputBlock(input.getArrayOfWritePointers(), numInputs, blockIdx * config.blockSize,
+                                      config.blockSize);
+        simulator.processBlock(inputBlock);
+    }
+    AudioBuffer<float> block(numInputs, config.blockSize);
+    AudioBuffer<float> beams(config.numBeams, config.blockSize);
+    
+    int64 processTicks = 0;
+    for (auto blockIdx = 0; blockIdx < numWarmupBlocks + numBlocks; blockIdx++) {
+        const int offset = (blockIdx % numInputBlocks) * config.blockSize;
+        for (auto chIdx = 0; chIdx < numInputs; chIdx++) {
+            block.copyFrom(chIdx, 0, input, chIdx, offset, config.blockSize);
+        }
+        
+        const auto startTick = Time::getHighResolutionTicks();
+        for (auto beamIdx = 0; beamIdx < config.numBeams; beamIdx++) {
+            beamformer.setBeamParameters(beamIdx, beamParams[beamIdx]);
+        }
+        beamformer.processBlock(block);
+        beamformer.getBeams(beams);
+        if (blockIdx >= numWarmupBlocks) {
+            processTicks += Time::getHighResolutionTicks() - startTick;
+        }
+    }
+    
+    const double processTime = Time::highResolutionTicksToSeconds(processTicks);
+    const double numSamples = (double) numBlocks * config.blockSize;
+    
+    Result result;
+    result.config = config;
+    result.nsPerSample = processTime * 1e9 / numSamples;
+    result.realtimeFactor = processTime > 0 ? (numSamples / config.sampleRate) / processTime : 0;
+    result.doaUpdateTime = beamformer.getDoaUpdateTime();
+    result.peakMemory = getPeakMemory();
+    result.doaError = getDoaError(beamformer, sources);
+    return result;
+}
+
+var BeamformerBenchmark::toVar(const Result &result) {
+    auto obj = new DynamicObject();
+    obj->setProperty("micConfig", getArrayLayoutLabel(result.config.layout));
+    obj->setProperty("numMics", getNumMics(result.config.layout));
+    obj->setProperty("sampleRate", result.config.sampleRate);
+    obj->setProperty("blockSize", result.config.blockSize);
+    obj->setProperty("numBeams", result.config.numBeams);
+    obj->setProperty("nsPerSample", result.nsPerSample);
+    obj->setProperty("realtimeFactor", result.realtimeFactor);
+    obj->setProperty("doaUpdateTime", result.doaUpdateTime);
+    obj->setProperty("peakMemory", result.peakMemory);
+    obj->setProperty("doaError", result.doaError);
+    return var(obj);
+}
+
+float BeamformerBenchmark::getDoaError(const Beamformer &beamformer, const std::vector<ArraySimulator::Source> &sources) {
+    
+    /** Let the DOA thread consume what is left in its queue */
+    Mtx energy;
+    std::vector<DoaPeak> peaks;
+    for (auto attempt = 0; attempt < 50 && peaks.empty(); attempt++) {
+        beamformer.getDoaMap(energy, peaks);
+        if (peaks.empty())
+            Thread::sleep(10);
+    }
+    if (peaks.empty() || sources.empty())
+        return -1;
+    
+    /** Distance of each source from the closest peak */
+    float error = 0;
+    for (const auto &source : sources) {
+        float minDist = std::numeric_limits<float>::max();
+        for (const auto &peak : peaks) {
+            minDist = jmin(minDist, std::hypot(peak.doaX - source.doaX, peak.doaY - source.doaY));
+        }
+        error += minDist;
+    }
+    return error / sources.size();
+}
+
+int64 BeamformerBenchmark::getPeakMemory() {
+#if JUCE_WINDOWS
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return (int64) counters.PeakWorkingSetSize;
+    return -1;
+#elif JUCE_MAC || JUCE_LINUX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return -1;
+   #if JUCE_MAC
+    return (int64) usage.ru_maxrss;
+   #else
+    return (int64) usage.ru_maxrss * 1024;
+   #endif
+#else
+    return -1;
+#endif
+}
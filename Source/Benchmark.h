@@ -0,0 +1,111 @@
+/*
+ Headless Beamformer benchmark
+ 
+ Authors:
+ Luca Bondi (luca.bondi@polimi.it)
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "ebeamerDefs.h"
+#include "Beamformer.h"
+#include "ArraySimulator.h"
+
+/** Measure the Beamformer throughput outside a host.
+ 
+ Every combination of microphone configuration, sample rate, block size and number of beams is run in turn,
+ feeding the signals of an ArraySimulator with a source in the direction of each beam as fast as possible.
+ Besides the throughput, the accuracy of the DOA peaks against the simulated sources is reported. Results are written as JSON lines, one object per combination.
+ */
+class BeamformerBenchmark {
+    
+public:
+    
+    /** A benchmark combination */
+    typedef struct {
+        ArrayLayout layout;
+        double sampleRate;
+        int blockSize;
+        int numBeams;
+    } Config;
+    
+    /** Measurements of a combination */
+    typedef struct {
+        Config config;
+        /** Processing time per input sample [ns] */
+        double nsPerSample;
+        /** Audio duration over processing time */
+        double realtimeFactor;
+        /** Processing time of the last DOA update [s] */
+        double doaUpdateTime;
+        /** Peak memory of the process so far [bytes], -1 if not available */
+        int64 peakMemory;
+        /** Average distance of each source from the closest DOA peak, -1 if no peak is available */
+        float doaError;
+    } Result;
+    
+    /** Parse the command line options
+     
+     --sample-rates a,b,...   sample rates [Hz]
+     --block-sizes a,b,...    block sizes [samples]
+     --beams a,b,...          number of beams
+     --configs a,b,...        MicConfig indexes or eSticks per row times rows, e.g. 4x2.
+                              All the MicConfig ones and the larger layouts up to MAX_NUM_ESTICKS by default
+     --seconds s              audio duration processed per combination [s]
+     --noise dB               sensor noise level [dBFS]
+     --rt60 s                 reverberation time of the simulated sources [s], 0 for anechoic
+     --drr dB                 direct to reverberant ratio [dB]
+     --output file            write results to file instead of stdout
+     */
+    explicit BeamformerBenchmark(const ArgumentList &args);
+    
+    /** Run all the combinations, writing results as soon as available
+     
+     @return: process exit code
+     */
+    int run();
+    
+    /** Run a single combination */
+    Result runConfig(const Config &config) const;
+    
+    /** Result as a JSON object */
+    static var toVar(const Result &result);
+    
+    /** Average distance of the sources from the closest DOA peak, -1 if no peak is available */
+    static float getDoaError(const Beamformer &beamformer, const std::vector<ArraySimulator::Source> &sources);
+    
+    /** Peak resident memory of the process [bytes], -1 if not available */
+    static int64 getPeakMemory();
+    
+private:
+    
+    std::vector<ArrayLayout> layouts;
+    std::vector<double> sampleRates = {44100, 48000, 96000};
+    std::vector<int> blockSizes = {64, 256, 1024};
+    std::vector<int> numBeams = {1, NUM_BEAMS};
+    
+    /** Audio processed per combination [s] */
+    double secondsPerConfig = 2;
+    
+    /** Audio processed before measuring, per combination [s] */
+    const double warmupSeconds = 0.2;
+    
+    /** Simulated input looped during a combination [s] */
+    const double inputSeconds = 1;
+    
+    /** Level of each simulated source [dBFS] */
+    const float sourceLevel = -20;
+    
+    /** Sensor noise level [dBFS] */
+    float noiseLevel = -60;
+    
+    /** Reverberation of the simulated sources */
+    float rt60 = 0;
+    float directToReverbRatio = 10;
+    
+    /** Output file, stdout if not set */
+    File outputFile;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (BeamformerBenchmark)
+};
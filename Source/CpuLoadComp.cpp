@@ -16,6 +16,10 @@ CpuLoadComp::CpuLoadComp() {
     label.setJustificationType(Justification::left);
     label.attachToComponent(&text, true);
     addAndMakeVisible(text);
+    
+    /** Clicks are handled by the component to show the profiling report */
+    text.setInterceptsMouseClicks(false, false);
+    label.setInterceptsMouseClicks(false, false);
 }
 
 CpuLoadComp::~CpuLoadComp() {
@@ -34,8 +38,21 @@ void CpuLoadComp::resized() {
     text.setBounds(area);
 }
 
+void CpuLoadComp::mouseUp(const MouseEvent &e) {
+    if (callback == nullptr)
+        return;
+    
+    const String report = callback->getProfilingReport();
+    auto content = std::make_unique<Label>("profilingReport", report);
+    content->setFont(Font(Font::getDefaultMonospacedFontName(), 12, Font::plain));
+    content->setSize(420, 16 * (StringArray::fromLines(report).size() + 1));
+    CallOutBox::launchAsynchronously(std::move(content), getScreenBounds(), nullptr);
+}
+
 void CpuLoadComp::timerCallback() {
     if (callback == nullptr)
         return;
-    text.setText(String(int(callback->getCpuLoad() * 100)) + "%", NotificationType::dontSendNotification);
+    text.setText(String(int(callback->getCpuLoad() * 100)) + "% - DOA " +
+                 String(roundToInt(callback->getDoaUpdateTime() * 1000)) + " ms",
+                 NotificationType::dontSendNotification);
 }
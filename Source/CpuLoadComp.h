@@ -23,6 +23,12 @@ public:
         virtual ~Callback() = default;
 
         virtual float getCpuLoad() const = 0;
+
+        /** Processing time of the last DOA update [s] */
+        virtual float getDoaUpdateTime() const = 0;
+
+        /** Per-stage timing statistics of the audio thread */
+        virtual String getProfilingReport() const = 0;
     };
 
     void setSource(Callback *cb);
@@ -31,6 +37,9 @@ public:
 
     void resized() override;
 
+    /** Show the per-stage timing statistics */
+    void mouseUp(const MouseEvent &e) override;
+
 private:
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CpuLoadComp)
 
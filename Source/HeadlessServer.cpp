@@ -0,0 +1,260 @@
+/*
+ Headless multi-array beamforming server
+
+ Authors:
+ Luca Bondi (luca.bondi@polimi.it)
+*/
+
+#include "HeadlessServer.h"
+#include <iostream>
+
+//==============================================================================
+HeadlessPipeline::HeadlessPipeline(const var &s) {
+    name = s.getProperty("name", "").toString();
+    inputDevice = s.getProperty("input", "").toString();
+    outputDevice = s.getProperty("output", "").toString();
+    const String config = s.getProperty("config", 0).toString();
+    if (!parseArrayLayout(config, arrayLayout)) {
+        settingsError = "invalid config " + config;
+    }
+    cpu = s.getProperty("cpu", cpu);
+    /** The affinity mask has a bit per core, for the first 32 cores only */
+    if (cpu < -1 || cpu >= jmin(32, SystemStats::getNumCpus())) {
+        settingsError = "cpu " + String(cpu) + " out of range";
+    }
+    gainDb = s.getProperty("gain", gainDb);
+    hpfFreq = s.getProperty("hpf", hpfFreq);
+    settings.doaEnabled = s.getProperty("doa", settings.doaEnabled);
+    settings.geometryFile = s.getProperty("geometry", "").toString();
+    settings.nearfieldMinDistance = s.getProperty("nearfield", settings.nearfieldMinDistance);
+    if (auto *beamsArray = s.getProperty("beams", var()).getArray()) {
+        for (const auto &b : *beamsArray) {
+            beams.push_back({(float) b.getProperty("doaX", 0), (float) b.getProperty("doaY", 0),
+                             (float) b.getProperty("width", 0.2), (float) b.getProperty("distance", 0)});
+        }
+    }
+    if (beams.empty()) {
+        beams.push_back({0, 0, 0.2f});
+    }
+}
+
+HeadlessPipeline::~HeadlessPipeline() {
+    stop();
+}
+
+const String &HeadlessPipeline::getName() const {
+    return name;
+}
+
+String HeadlessPipeline::start(AudioIODeviceType &type, double sampleRate_, int blockSize) {
+    if (settingsError.isNotEmpty()) {
+        return settingsError;
+    }
+    device.reset(type.createDevice(outputDevice, inputDevice));
+    if (device == nullptr) {
+        return "cannot create device " + inputDevice;
+    }
+    BigInteger inputChannels, outputChannels;
+    inputChannels.setRange(0, getNumMics(arrayLayout), true);
+    if (outputDevice.isNotEmpty())
+        outputChannels.setRange(0, (int) beams.size(), true);
+    const String error = device->open(inputChannels, outputChannels, sampleRate_, blockSize);
+    if (error.isNotEmpty()) {
+        device = nullptr;
+        return error;
+    }
+    device->start(this);
+    return {};
+}
+
+void HeadlessPipeline::stop() {
+    if (device != nullptr) {
+        device->stop();
+        device->close();
+        device = nullptr;
+    }
+}
+
+void HeadlessPipeline::audioDeviceAboutToStart(AudioIODevice *d) {
+    sampleRate = d->getCurrentSampleRate();
+    const int blockSize = d->getCurrentBufferSizeSamples();
+    const int numMic = getNumMics(arrayLayout);
+
+    beamformer = std::make_unique<Beamformer>((int) beams.size(), arrayLayout, sampleRate, blockSize, settings);
+    for (auto beamIdx = 0; beamIdx < (int) beams.size(); beamIdx++) {
+        beamformer->setBeamParameters(beamIdx, beams[beamIdx], false);
+    }
+
+    inputBuffer.setSize(numMic, blockSize);
+    beamBuffer.setSize((int) beams.size(), blockSize);
+
+    iirHPFfilters.resize(numMic);
+    for (auto &f : iirHPFfilters) {
+        f.setCoefficients(IIRCoefficients::makeHighPass(sampleRate, hpfFreq));
+        f.reset();
+    }
+
+    pinned = false;
+}
+
+void HeadlessPipeline::audioDeviceStopped() {
+    beamformer = nullptr;
+}
+
+void HeadlessPipeline::audioDeviceIOCallback(const float **inputChannelData, int numInputChannels,
+                                             float **outputChannelData, int numOutputChannels, int numSamples) {
+
+    const auto startTick = Time::getHighResolutionTicks();
+
+    if (!pinned) {
+        if (cpu >= 0)
+            Thread::setCurrentThreadAffinityMask((uint32) 1 << cpu);
+        pinned = true;
+    }
+
+    /** Blocks larger than the prepared size are processed in chunks of it, so that every output sample is written */
+    const int chunkSize = inputBuffer.getNumSamples();
+    for (auto offset = 0; offset < numSamples; offset += chunkSize) {
+        processChunk(inputChannelData, numInputChannels, outputChannelData, numOutputChannels, offset,
+                     jmin(chunkSize, numSamples - offset));
+    }
+
+    /** Load and deadline */
+    const float elapsed = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - startTick);
+    const float blockDuration = numSamples / sampleRate;
+    const float blockLoad = elapsed / blockDuration;
+    const float loadAlpha = 1 - exp(-blockDuration / loadTimeConst);
+    load = load + loadAlpha * (blockLoad - load);
+    /** The report thread resets maxLoad concurrently, a plain read then store could lose a peak or undo the reset */
+    float prevMaxLoad = maxLoad.load();
+    while (blockLoad > prevMaxLoad && !maxLoad.compare_exchange_weak(prevMaxLoad, blockLoad)) {
+    }
+    numBlocks++;
+    if (blockLoad > deadlineFraction)
+        numDeadlineMisses++;
+    beamformer->setAudioLoad(load);
+    doaUpdateTime = beamformer->getDoaUpdateTime();
+}
+
+void HeadlessPipeline::processChunk(const float **inputChannelData, int numInputChannels, float **outputChannelData,
+                                    int numOutputChannels, int offset, int numSamples) {
+
+    /** Input gain and HPF */
+    const float gain = Decibels::decibelsToGain(gainDb);
+    for (auto chIdx = 0; chIdx < inputBuffer.getNumChannels(); chIdx++) {
+        if (chIdx < numInputChannels && inputChannelData[chIdx] != nullptr) {
+            FloatVectorOperations::multiply(inputBuffer.getWritePointer(chIdx), inputChannelData[chIdx] + offset, gain,
+                                            numSamples);
+            iirHPFfilters[chIdx].processSamples(inputBuffer.getWritePointer(chIdx), numSamples);
+        } else {
+            inputBuffer.clear(chIdx, 0, numSamples);
+        }
+    }
+
+    /** Beamforming */
+    AudioBuffer<float> input(inputBuffer.getArrayOfWritePointers(), inputBuffer.getNumChannels(), numSamples);
+    AudioBuffer<float> output(beamBuffer.getArrayOfWritePointers(), beamBuffer.getNumChannels(), numSamples);
+    beamformer->processBlock(input);
+    beamformer->getBeams(output);
+
+    for (auto chIdx = 0; chIdx < numOutputChannels; chIdx++) {
+        if (outputChannelData[chIdx] == nullptr)
+            continue;
+        if (chIdx < output.getNumChannels())
+            FloatVectorOperations::copy(outputChannelData[chIdx] + offset, output.getReadPointer(chIdx), numSamples);
+        else
+            FloatVectorOperations::clear(outputChannelData[chIdx] + offset, numSamples);
+    }
+}
+
+var HeadlessPipeline::getReport() {
+    auto obj = new DynamicObject();
+    obj->setProperty("time", Time::getCurrentTime().toISO8601(true));
+    obj->setProperty("pipeline", name);
+    obj->setProperty("running", device != nullptr && device->isPlaying());
+    obj->setProperty("load", load.load());
+    obj->setProperty("maxLoad", maxLoad.exchange(0));
+    obj->setProperty("blocks", numBlocks.load());
+    obj->setProperty("deadlineMisses", numDeadlineMisses.load());
+    obj->setProperty("xruns", device != nullptr ? device->getXRunCount() : -1);
+    obj->setProperty("doaUpdateTime", doaUpdateTime.load());
+    return var(obj);
+}
+
+//==============================================================================
+HeadlessServer::HeadlessServer(const ArgumentList &args) {
+    configFile = args.getFileForOption("--headless");
+    if (args.containsOption("--report-seconds"))
+        reportSeconds = jmax(0.1, args.getValueForOption("--report-seconds").getDoubleValue());
+    if (args.containsOption("--log"))
+        logFile = args.getFileForOption("--log");
+}
+
+HeadlessServer::~HeadlessServer() {
+    stopTimer();
+    /** Stop every device before any pipeline is destroyed */
+    for (auto *p : pipelines)
+        p->stop();
+    pipelines.clear();
+}
+
+bool HeadlessServer::start() {
+
+    if (logFile != File()) {
+        log = std::make_unique<FileOutputStream>(logFile);
+        if (static_cast<FileOutputStream *>(log.get())->failedToOpen()) {
+            std::cerr << "Cannot open " << logFile.getFullPathName() << std::endl;
+            return false;
+        }
+    }
+
+    var config;
+    const auto result = JSON::parse(configFile.loadFileAsString(), config);
+    if (result.failed() || config.getProperty("pipelines", var()).getArray() == nullptr) {
+        std::cerr << "Invalid configuration " << configFile.getFullPathName() << ": " << result.getErrorMessage()
+                  << std::endl;
+        return false;
+    }
+
+    const String deviceTypeName = config.getProperty("deviceType", "");
+    const double sampleRate = config.getProperty("sampleRate", 48000);
+    const int blockSize = config.getProperty("blockSize", 256);
+
+    AudioDeviceManager().createAudioDeviceTypes(deviceTypes);
+    AudioIODeviceType *type = deviceTypes.getFirst();
+    for (auto *t : deviceTypes) {
+        if (t->getTypeName() == deviceTypeName)
+            type = t;
+    }
+    if (type == nullptr) {
+        std::cerr << "No audio device type available" << std::endl;
+        return false;
+    }
+    type->scanForDevices();
+
+    for (const auto &settings : *config.getProperty("pipelines", var()).getArray()) {
+        auto *pipeline = pipelines.add(new HeadlessPipeline(settings));
+        const String error = pipeline->start(*type, sampleRate, blockSize);
+        if (error.isNotEmpty()) {
+            std::cerr << "Cannot start pipeline " << pipeline->getName() << ": " << error << std::endl;
+            return false;
+        }
+    }
+
+    startTimer(roundToInt(reportSeconds * 1000));
+    return true;
+}
+
+void HeadlessServer::writeLine(const String &line) {
+    if (log != nullptr) {
+        *log << line << newLine;
+        log->flush();
+    } else {
+        std::cout << line << std::endl;
+    }
+}
+
+void HeadlessServer::timerCallback() {
+    for (auto *p : pipelines)
+        writeLine(JSON::toString(p->getReport(), true));
+}
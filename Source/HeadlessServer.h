@@ -0,0 +1,161 @@
+/*
+ Headless multi-array beamforming server
+
+ Authors:
+ Luca Bondi (luca.bondi@polimi.it)
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "ebeamerDefs.h"
+#include "Beamformer.h"
+
+/** A Beamformer fed by the audio device of one array, with no editor
+
+ Input gain and HPF are applied as in the plugin, the beams are sent to the output channels of the device, if any.
+ The audio callback thread is pinned to the configured core the first time it runs.
+ */
+class HeadlessPipeline : public AudioIODeviceCallback {
+
+public:
+
+    /** Read the pipeline settings, a JSON object
+
+     name         label used in the reports
+     input        input device name
+     output       output device name, no output if empty
+     config       MicConfig index, or eSticks per row times rows, e.g. "4x2"
+     cpu          core the audio thread is pinned to, -1 to leave it floating. One of the first 32 cores
+     gain         input gain [dB]
+     hpf          high pass filter cut frequency [Hz]
+     doa          estimate the directions of arrival
+     geometry     microphone positions file, see ArrayGeometry. Regular grid of eSticks if not given
+     nearfield    closest focal distance of the beams [m], 0 or not given for far-field beams only
+     beams        array of {doaX, doaY, width, distance}, with the same ranges as the plugin
+     */
+    explicit HeadlessPipeline(const var &settings);
+
+    ~HeadlessPipeline() override;
+
+    /** Open and start the device
+
+     @return: error message, empty on success. Invalid settings are reported here too
+     */
+    String start(AudioIODeviceType &type, double sampleRate, int blockSize);
+
+    /** Stop and close the device */
+    void stop();
+
+    /** Load and deadline statistics as a JSON object. The maximum load is reset at every call. */
+    var getReport();
+
+    /** Label of the pipeline */
+    const String &getName() const;
+
+    //==============================================================================
+    void audioDeviceIOCallback(const float **inputChannelData, int numInputChannels, float **outputChannelData,
+                               int numOutputChannels, int numSamples) override;
+
+    void audioDeviceAboutToStart(AudioIODevice *device) override;
+
+    void audioDeviceStopped() override;
+
+private:
+
+    /** Condition, beamform and output a chunk of at most the prepared block size, starting at offset */
+    void processChunk(const float **inputChannelData, int numInputChannels, float **outputChannelData,
+                      int numOutputChannels, int offset, int numSamples);
+
+    String name, inputDevice, outputDevice;
+    ArrayLayout arrayLayout = {1, 1};
+
+    /** First invalid setting found by the constructor, empty if none */
+    String settingsError;
+    int cpu = -1;
+    float gainDb = 0;
+    float hpfFreq = 250;
+    BeamformerSettings settings;
+    std::vector<BeamParameters> beams;
+
+    std::unique_ptr<AudioIODevice> device;
+    std::unique_ptr<Beamformer> beamformer;
+
+    /** Conditioned input and beams, audio thread only */
+    AudioBuffer<float> inputBuffer, beamBuffer;
+    std::vector<IIRFilter> iirHPFfilters;
+
+    /** The audio thread has been pinned already */
+    bool pinned = false;
+
+    double sampleRate = 48000;
+
+    /** Load time constant [s] */
+    const float loadTimeConst = 1;
+
+    /** Fraction of the block duration after which a block is considered late */
+    const float deadlineFraction = 1;
+
+    /** Statistics, written by the audio thread */
+    std::atomic<float> load{0};
+    std::atomic<float> maxLoad{0};
+    std::atomic<int64> numBlocks{0};
+    std::atomic<int64> numDeadlineMisses{0};
+    /** Processing time of the last DOA update [s], copied from the beamformer, which only the device thread may access */
+    std::atomic<float> doaUpdateTime{0};
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (HeadlessPipeline)
+};
+
+/** Run several independent beamforming pipelines, one per array, without any GUI
+
+ The pipelines are described by a JSON file:
+
+ {
+   "deviceType": "ALSA",
+   "sampleRate": 48000,
+   "blockSize": 256,
+   "pipelines": [ {see HeadlessPipeline}, ... ]
+ }
+
+ Every reporting period a JSON line per pipeline is written with its average and maximum load and
+ the number of blocks that missed their deadline so far.
+ */
+class HeadlessServer : private Timer {
+
+public:
+
+    /** Parse the command line options
+
+     --headless file          pipelines configuration
+     --report-seconds s       reporting period [s]
+     --log file               append reports to file instead of stdout
+     */
+    explicit HeadlessServer(const ArgumentList &args);
+
+    ~HeadlessServer() override;
+
+    /** Start all the pipelines and the periodic reports
+
+     @return: false if any pipeline cannot be started, errors are written to stderr
+     */
+    bool start();
+
+private:
+
+    File configFile;
+    File logFile;
+    double reportSeconds = 5;
+
+    OwnedArray<AudioIODeviceType> deviceTypes;
+    OwnedArray<HeadlessPipeline> pipelines;
+
+    std::unique_ptr<OutputStream> log;
+
+    /** Write a line to the log, or to stdout */
+    void writeLine(const String &line);
+
+    void timerCallback() override;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (HeadlessServer)
+};
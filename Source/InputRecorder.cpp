@@ -0,0 +1,223 @@
+/*
+ Raw array input recorder
+ 
+ Authors:
+ Luca Bondi (luca.bondi@polimi.it)
+*/
+
+#include "InputRecorder.h"
+
+#if JUCE_LINUX
+ #include <fcntl.h>
+ #include <unistd.h>
+ #include <linux/falloc.h>
+#elif JUCE_MAC
+ #include <fcntl.h>
+ #include <unistd.h>
+#endif
+
+InputRecorder::InputRecorder() : Thread("Input recorder") {
+    
+}
+
+InputRecorder::~InputRecorder() {
+    stop();
+}
+
+void InputRecorder::prepare(int numChannels_, double sampleRate_, int maximumBlockSize) {
+    
+    const bool wasRecording = isRecording();
+    stop();
+    
+    numChannels = numChannels_;
+    sampleRate = sampleRate_;
+    const int batchLen = roundToInt(batchSeconds * sampleRate);
+    auto newFifo = std::make_unique<AudioBufferFifo>(numChannels, jmax(roundToInt(fifoSeconds * sampleRate),
+                                                                       batchLen + 2 * maximumBlockSize));
+    batch.setSize(numChannels, batchLen);
+    {
+        const SpinLock::ScopedLockType l(fifoLock);
+        std::swap(fifo, newFifo);
+    }
+    
+    if (wasRecording) {
+        start(folder);
+    }
+}
+
+bool InputRecorder::start(const File &folder_) {
+    
+    stop();
+    
+    if (fifo == nullptr || numChannels == 0) {
+        return false;
+    }
+    
+    folder = folder_;
+    if (!openFile()) {
+        return false;
+    }
+    
+    /** Leftovers from the previous recording, if any */
+    fifo->discard(fifo->getNumReady());
+    numDroppedSamples = 0;
+    
+    startThread();
+    recording = true;
+    return true;
+}
+
+void InputRecorder::stop() {
+    
+    recording = false;
+    
+    /** The writer thread writes what is left in the FIFO before exiting */
+    signalThreadShouldExit();
+    waitForThreadToExit(-1);
+    if (writer == nullptr) {
+        return;
+    }
+    /** Closing the writer finalizes the header */
+    writer = nullptr;
+    closeFile();
+    
+    if (numDroppedSamples > 0) {
+        Logger::writeToLog(file.getFullPathName() + ": " + String(numDroppedSamples.load())
+                           + " samples dropped, the disk could not keep up");
+    }
+}
+
+bool InputRecorder::isRecording() const {
+    return recording;
+}
+
+void InputRecorder::push(const AudioBuffer<float> &buffer) {
+    if (!recording) {
+        return;
+    }
+    const SpinLock::ScopedTryLockType l(fifoLock);
+    if (!l.isLocked()) {
+        return;
+    }
+    const int numSamples = buffer.getNumSamples();
+    const int numPushed = fifo->push(buffer, 0, numSamples);
+    if (numPushed < numSamples) {
+        numDroppedSamples += numSamples - numPushed;
+    }
+}
+
+int64 InputRecorder::getNumDroppedSamples() const {
+    return numDroppedSamples;
+}
+
+File InputRecorder::getFile() const {
+    return file;
+}
+
+bool InputRecorder::openFile() {
+    
+    folder.createDirectory();
+    file = folder.getNonexistentChildFile("eBeamer-" + Time::getCurrentTime().formatted("%Y%m%d-%H%M%S"), ".wav");
+    
+    std::unique_ptr<FileOutputStream> stream(file.createOutputStream());
+    if (stream == nullptr) {
+        return false;
+    }
+    
+    WavAudioFormat wav;
+    writer.reset(wav.createWriterFor(stream.get(), sampleRate, (unsigned int) numChannels, bitsPerSample, {}, 0));
+    if (writer == nullptr) {
+        return false;
+    }
+    /** The writer owns the stream */
+    stream.release();
+    
+    numBytesWritten = 0;
+    numBytesReserved = 0;
+#if JUCE_LINUX || JUCE_MAC
+    fileDescriptor = open(file.getFullPathName().toRawUTF8(), O_WRONLY);
+#endif
+    return true;
+}
+
+void InputRecorder::closeFile() {
+#if JUCE_LINUX || JUCE_MAC
+    if (fileDescriptor < 0) {
+        return;
+    }
+    const off_t fileSize = lseek(fileDescriptor, 0, SEEK_END);
+#if JUCE_LINUX
+    /** Blocks reserved with FALLOC_FL_KEEP_SIZE stay allocated past the end of the file until released */
+    if (fileSize >= 0 && numBytesReserved > fileSize && numBytesReserved != std::numeric_limits<int64>::max()) {
+        fallocate(fileDescriptor, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, fileSize, numBytesReserved - fileSize);
+    }
+#else
+    /** Truncating releases the preallocated space past the end of the file */
+    if (fileSize >= 0) {
+        ignoreUnused(ftruncate(fileDescriptor, fileSize));
+    }
+#endif
+    close(fileDescriptor);
+    fileDescriptor = -1;
+#endif
+}
+
+void InputRecorder::run() {
+    
+    const int batchLen = batch.getNumSamples();
+    
+    while (!threadShouldExit()) {
+        wait(pollMs);
+        while (fifo->getNumReady() >= batchLen && !threadShouldExit()) {
+            writeBatch(batchLen);
+        }
+    }
+    
+    /** Drain */
+    while (fifo->getNumReady() > 0) {
+        writeBatch(jmin(batchLen, fifo->getNumReady()));
+    }
+    writer->flush();
+}
+
+void InputRecorder::writeBatch(int numSamples) {
+    
+    const int64 numBytes = (int64) numSamples * numChannels * bitsPerSample / 8;
+    if (numBytesWritten + numBytes > numBytesReserved) {
+        const int64 extentBytes = (int64) (extentSeconds * sampleRate) * numChannels * bitsPerSample / 8;
+        if (reserveSpace(numBytesReserved, extentBytes)) {
+            numBytesReserved += extentBytes;
+        } else {
+            /** Not supported, do not try again */
+            numBytesReserved = std::numeric_limits<int64>::max();
+        }
+    }
+    
+    fifo->pop(batch, 0, numSamples);
+    writer->writeFromAudioSampleBuffer(batch, 0, numSamples);
+    numBytesWritten += numBytes;
+}
+
+bool InputRecorder::reserveSpace(int64 offset, int64 numBytes) {
+#if JUCE_LINUX
+    if (fileDescriptor < 0)
+        return false;
+    return fallocate(fileDescriptor, FALLOC_FL_KEEP_SIZE, offset, numBytes) == 0;
+#elif JUCE_MAC
+    if (fileDescriptor < 0)
+        return false;
+    /** Relative to the space already allocated */
+    ignoreUnused(offset);
+    fstore_t store = {F_ALLOCATECONTIG, F_PEOFPOSMODE, 0, numBytes, 0};
+    bool ok = fcntl(fileDescriptor, F_PREALLOCATE, &store) != -1;
+    if (!ok) {
+        /** Fragmented space */
+        store.fst_flags = F_ALLOCATEALL;
+        ok = fcntl(fileDescriptor, F_PREALLOCATE, &store) != -1;
+    }
+    return ok;
+#else
+    ignoreUnused(offset, numBytes);
+    return false;
+#endif
+}
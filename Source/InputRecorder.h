@@ -0,0 +1,121 @@
+/*
+ Raw array input recorder
+ 
+ Authors:
+ Luca Bondi (luca.bondi@polimi.it)
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "AudioBufferFifo.h"
+
+/** Capture the microphone signals to disk, for later re-processing
+ 
+ The audio thread pushes its blocks into a preallocated lock-free FIFO and never touches the disk.
+ A background thread pops large batches and writes them sequentially to a multichannel WAV file,
+ switching to RF64 beyond 4 GB. The file space is reserved ahead of the writes in large extents, where the platform
+ allows it, to keep the file contiguous and the metadata updates rare.
+ If the disk cannot keep up for longer than the FIFO duration, samples are dropped, counted and logged on stop.
+ */
+class InputRecorder : private Thread {
+    
+public:
+    
+    InputRecorder();
+    
+    ~InputRecorder();
+    
+    /** Allocate the FIFO for a new stream format. Message thread only, push may run concurrently.
+     
+     A recording in progress is closed and continues in a new file with the new format.
+     The pending samples are written and the new FIFO is allocated before swapping it in,
+     hence push is only held off, and skipped, for the swap itself.
+     */
+    void prepare(int numChannels, double sampleRate, int maximumBlockSize);
+    
+    /** Start recording to a new file in a folder. Message thread only.
+     
+     @return: false if the file cannot be created or prepare was not called
+     */
+    bool start(const File &folder);
+    
+    /** Stop recording, writing the pending samples and closing the file. Message thread only.
+     
+     The reserved space past the end of the file is released, and the dropped samples, if any, are logged.
+     */
+    void stop();
+    
+    /** True while recording */
+    bool isRecording() const;
+    
+    /** Push the first numChannels of a block. Audio thread only, wait-free. Ignored when not recording. */
+    void push(const AudioBuffer<float> &buffer);
+    
+    /** Number of samples dropped since start because the FIFO was full */
+    int64 getNumDroppedSamples() const;
+    
+    /** File being recorded, or last file recorded */
+    File getFile() const;
+    
+private:
+    
+    /** Writer thread */
+    void run() override;
+    
+    /** Pop and write a batch of samples */
+    void writeBatch(int numSamples);
+    
+    /** Create the file, its writer and the descriptor used to reserve space */
+    bool openFile();
+    
+    /** Release the reserved space past the end of the closed file and close the descriptor */
+    void closeFile();
+    
+    /** Reserve disk space for the file from offset on, without changing its size */
+    bool reserveSpace(int64 offset, int64 numBytes);
+    
+    /** FIFO duration [s]. The longest disk stall that does not drop samples */
+    const double fifoSeconds = 4;
+    
+    /** Duration of a write [s] */
+    const double batchSeconds = 0.25;
+    
+    /** Duration of a reserved extent [s] */
+    const double extentSeconds = 60;
+    
+    /** Writer thread polling period [ms] */
+    const int pollMs = 20;
+    
+    const int bitsPerSample = 24;
+    
+    int numChannels = 0;
+    double sampleRate = 0;
+    
+    std::unique_ptr<AudioBufferFifo> fifo;
+    
+    /** Held by push while it uses fifo, and by prepare to replace it */
+    SpinLock fifoLock;
+    
+    /** Samples of a write, owned by the writer thread */
+    AudioBuffer<float> batch;
+    
+    std::unique_ptr<AudioFormatWriter> writer;
+    
+    /** Bytes written and reserved so far */
+    int64 numBytesWritten = 0;
+    int64 numBytesReserved = 0;
+    
+    /** Recording folder and current file */
+    File folder;
+    File file;
+    
+    /** Descriptor of the current file for the space reservation, -1 if none */
+    int fileDescriptor = -1;
+    
+    std::atomic<bool> recording{false};
+    
+    std::atomic<int64> numDroppedSamples{0};
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (InputRecorder)
+};
@@ -26,22 +26,33 @@ void RoundLed::resized() {
 
 
 void MultiChannelLedBar::makeLayout() {
-    removeAllChildren();
-    leds.clear();
     if (callback == nullptr) {
         return;
     }
     callback->getMeterValues(values, meterId);
     auto num = values.size();
-    for (auto ledIdx = 0; ledIdx < num; ++ledIdx) {
-        leds.push_back(std::make_unique<RoundLed>());
-        leds[ledIdx]->colour = Colours::grey;
-        addAndMakeVisible(leds[ledIdx].get());
-    }
+    ledAreas.assign(num, {});
+    colours.assign(num, Colours::grey);
+    holdColours.assign(num, Colours::grey);
+    holdValues.assign(num, -100);
+    holdTicks.assign(num, 0);
     resized();
+    repaint();
 }
 
-void MultiChannelLedBar::paint(Graphics &) {
+void MultiChannelLedBar::paint(Graphics &g) {
+    
+    for (auto ledIdx = 0; ledIdx < ledAreas.size(); ++ledIdx) {
+        /** Round LED in the centre of its area, as RoundLed */
+        const auto side = jmin(ledAreas[ledIdx].getWidth(), ledAreas[ledIdx].getHeight());
+        const auto led = Rectangle<float>(side, side).withCentre(ledAreas[ledIdx].getCentre());
+        g.setColour(colours[ledIdx]);
+        g.fillEllipse(led);
+        if (holdColours[ledIdx] != colours[ledIdx]) {
+            g.setColour(holdColours[ledIdx]);
+            g.drawEllipse(led.reduced(0.75f), 1.5f);
+        }
+    }
     
 }
 
@@ -70,9 +81,9 @@ void MultiChannelLedBar::resized() {
     }
     area.setCentre(areaCtr);
     
-    for (auto ledIdx = 0; ledIdx < num; ++ledIdx) {
+    for (auto ledIdx = 0; ledIdx < jmin(num, ledAreas.size()); ++ledIdx) {
         Rectangle<int> ledArea = isHorizontal ? area.removeFromLeft(step) : area.removeFromTop(step);
-        leds[ledIdx]->setBounds(ledArea);
+        ledAreas[ledIdx] = ledArea.toFloat();
     }
     
 }
@@ -100,13 +111,28 @@ void MultiChannelLedBar::timerCallback() {
     
     callback->getMeterValues(values, meterId);
     
-    if (values.size() != leds.size())
+    if (values.size() != ledAreas.size())
         makeLayout();
     
-    for (auto ledIdx = 0; ledIdx < leds.size(); ++ledIdx)
-        leds[ledIdx]->colour = dbToColor(Decibels::gainToDecibels(values.at(ledIdx)));
-    
-    repaint();
+    const int maxHoldTicks = roundToInt(peakHoldSeconds * 1000 / jmax(1, getTimerInterval()));
+    
+    /** Only the LEDs that changed colour are repainted */
+    for (auto ledIdx = 0; ledIdx < ledAreas.size(); ++ledIdx) {
+        const float valueDb = Decibels::gainToDecibels(values[ledIdx]);
+        if (valueDb >= holdValues[ledIdx] || holdTicks[ledIdx] <= 0) {
+            holdValues[ledIdx] = valueDb;
+            holdTicks[ledIdx] = maxHoldTicks;
+        } else {
+            holdTicks[ledIdx]--;
+        }
+        const auto col = dbToColor(valueDb);
+        const auto holdCol = maxHoldTicks > 0 ? dbToColor(holdValues[ledIdx]) : col;
+        if (col != colours[ledIdx] || holdCol != holdColours[ledIdx]) {
+            colours[ledIdx] = col;
+            holdColours[ledIdx] = holdCol;
+            repaint(ledAreas[ledIdx].getSmallestIntegerContainer());
+        }
+    }
 }
 
 void MultiChannelLedBar::setCallback(MeterDecay::Callback *cb, int metId) {
@@ -166,10 +192,14 @@ void SingleChannelLedBar::timerCallback() {
         return;
     
     auto valueDb = Decibels::gainToDecibels(provider->getMeterValue(meterId, channel));
-    for (auto ledIdx = 0; ledIdx < leds.size(); ++ledIdx)
-        leds[ledIdx]->colour = dbToColour(valueDb, th[ledIdx]);
-    
-    repaint();
+    /** Only the LEDs that changed colour are repainted */
+    for (auto ledIdx = 0; ledIdx < leds.size(); ++ledIdx) {
+        const auto col = dbToColour(valueDb, th[ledIdx]);
+        if (col != leds[ledIdx]->colour) {
+            leds[ledIdx]->colour = col;
+            leds[ledIdx]->repaint();
+        }
+    }
 }
 
 Colour SingleChannelLedBar::dbToColour(float valDb, float thDb) {
@@ -37,6 +37,11 @@ private:
 
 
 //==============================================================================
+/** One LED per channel, all painted by this component from a single values array
+
+ Optionally, each LED holds the colour of its recent peak as an outer ring.
+ All the per-channel state is allocated when the number of channels changes, not at every tick.
+ */
 class MultiChannelLedBar : public Component, public Timer {
 public:
     
@@ -54,6 +59,9 @@ public:
     
     void setVertical() { isHorizontal = false; };
     
+    /** Hold the peak of each channel for a given time [s]. 0 to disable. */
+    void setPeakHold(float seconds) { peakHoldSeconds = seconds; };
+    
     static Colour dbToColor(float valDb);
     
     
@@ -64,9 +72,20 @@ private:
     
     bool isHorizontal = true;
     
-    std::vector<std::unique_ptr<RoundLed>> leds;
     std::vector<float> values;
     
+    /** Area, colour and peak hold colour of each LED */
+    std::vector<Rectangle<float>> ledAreas;
+    std::vector<Colour> colours;
+    std::vector<Colour> holdColours;
+    
+    /** Held peak of each channel [dB] and remaining timer ticks before it is released */
+    std::vector<float> holdValues;
+    std::vector<int> holdTicks;
+    
+    /** Peak hold time [s] */
+    float peakHoldSeconds = 0;
+    
     void timerCallback() override;
     
     void makeLayout();
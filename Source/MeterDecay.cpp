@@ -11,50 +11,102 @@
 
 MeterDecay::MeterDecay(float fs, float duration, float blockSize, int numChannels) {
 
-    int numBlocks = (int) ceil(duration * fs / blockSize);
+    numBlocks = jmax(1, (int) ceil(duration * fs / blockSize));
 
-    minMaxCircularBuffer.resize(numChannels);
-    idxs.resize(numChannels);
+    queues.resize(numChannels);
+    for (auto &queue : queues) {
+        queue.values.resize(numBlocks);
+        queue.blockIdxs.resize(numBlocks);
+    }
+
+    blockPeaks.resize(numChannels);
+    blockSumSquares.resize(numChannels);
+    sumSquaresHistory.resize(numChannels, std::vector<float>(numBlocks, 0));
+    windowSumSquares.resize(numChannels, 0);
+    numSamplesHistory.resize(numBlocks, 0);
+
+    numPeaks = numChannels;
+    peaks.reset(new std::atomic<float>[numChannels]);
+    rms.reset(new std::atomic<float>[numChannels]);
     for (auto channelIdx = 0; channelIdx < numChannels; ++channelIdx) {
-        idxs[channelIdx] = 0;
-        minMaxCircularBuffer[channelIdx].resize(numBlocks);
+        peaks[channelIdx] = 0;
+        rms[channelIdx] = 0;
     }
 
 }
 
+void MeterDecay::pushPeak(PeakQueue &queue, float value) {
+
+    /** Out of the window */
+    while (queue.size > 0 && queue.blockIdxs[queue.front] <= blockIdx - numBlocks) {
+        queue.front = (queue.front + 1) % numBlocks;
+        queue.size--;
+    }
+    /** Dominated by the new value, hence never the maximum again */
+    while (queue.size > 0 && queue.values[(queue.front + queue.size - 1) % numBlocks] <= value) {
+        queue.size--;
+    }
+    const int backIdx = (queue.front + queue.size) % numBlocks;
+    queue.values[backIdx] = value;
+    queue.blockIdxs[backIdx] = blockIdx;
+    queue.size++;
+}
+
 void MeterDecay::push(const AudioBuffer<float> &signal) {
-    GenericScopedLock<SpinLock> l(minMaxCircularBufferLock);
-
-    for (auto channelIdx = 0; channelIdx < jmin((int)signal.getNumChannels(),(int)minMaxCircularBuffer.size()); ++channelIdx) {
-        Range<float> minMax = FloatVectorOperations::findMinAndMax(signal.getReadPointer(channelIdx),
-                                                                   signal.getNumSamples());
-        float maxAbs = jmax(abs(minMax.getStart()), abs(minMax.getEnd()));
-        minMaxCircularBuffer[channelIdx][idxs[channelIdx]++] = maxAbs;
-        if (idxs[channelIdx] >= minMaxCircularBuffer[channelIdx].size()) {
-            idxs[channelIdx] = 0;
-        }
+
+    const int numChannels = jmin((int)signal.getNumChannels(),(int)queues.size());
+    measureLevels(signal, numChannels, blockPeaks.data(), blockSumSquares.data());
+    pushLevels(numChannels, signal.getNumSamples());
+}
+
+void MeterDecay::applyGainAndPush(AudioBuffer<float> &signal, float gain) {
+
+    const int numChannels = jmin((int)signal.getNumChannels(),(int)queues.size());
+    applyGainAndMeasureLevels(signal, numChannels, gain, blockPeaks.data(), blockSumSquares.data());
+    pushLevels(numChannels, signal.getNumSamples());
+}
+
+void MeterDecay::pushLevels(int numChannels, int numSamples) {
+
+    /** The oldest block leaves the window */
+    const int historyIdx = (int) (blockIdx % numBlocks);
+    windowNumSamples += numSamples - numSamplesHistory[historyIdx];
+    numSamplesHistory[historyIdx] = numSamples;
+
+    for (auto channelIdx = 0; channelIdx < numChannels; ++channelIdx) {
+        PeakQueue &queue = queues[channelIdx];
+        pushPeak(queue, blockPeaks[channelIdx]);
+        peaks[channelIdx].store(queue.values[queue.front], std::memory_order_relaxed);
+
+        windowSumSquares[channelIdx] += blockSumSquares[channelIdx] - sumSquaresHistory[channelIdx][historyIdx];
+        sumSquaresHistory[channelIdx][historyIdx] = blockSumSquares[channelIdx];
+        /** Rounding of the running sum can make it slightly negative */
+        const double meanSquare = windowNumSamples > 0 ? jmax(0.0, windowSumSquares[channelIdx]) / windowNumSamples : 0;
+        rms[channelIdx].store((float) std::sqrt(meanSquare), std::memory_order_relaxed);
     }
+    blockIdx++;
 }
 
 void MeterDecay::get(std::vector<float> &values) const {
-    GenericScopedLock<SpinLock> l(minMaxCircularBufferLock);
-    values.resize(minMaxCircularBuffer.size());
-    for (auto channelIdx = 0; channelIdx < minMaxCircularBuffer.size(); ++channelIdx) {
-        float maxVal = 0;
-        for (auto idx = 0; idx < minMaxCircularBuffer[channelIdx].size(); ++idx) {
-            maxVal = jmax(maxVal, minMaxCircularBuffer[channelIdx][idx]);
-        }
-        values[channelIdx] = maxVal;
+    values.resize(numPeaks);
+    for (auto channelIdx = 0; channelIdx < numPeaks; ++channelIdx) {
+        values[channelIdx] = peaks[channelIdx].load(std::memory_order_relaxed);
     }
 }
 
 float MeterDecay::get(int ch) const {
-    GenericScopedLock<SpinLock> l(minMaxCircularBufferLock);
-    float maxVal = 0;
-    for (auto idx = 0; idx < minMaxCircularBuffer[ch].size(); ++idx) {
-        maxVal = jmax(maxVal, minMaxCircularBuffer[ch][idx]);
+    return peaks[ch].load(std::memory_order_relaxed);
+}
+
+void MeterDecay::getRms(std::vector<float> &values) const {
+    values.resize(numPeaks);
+    for (auto channelIdx = 0; channelIdx < numPeaks; ++channelIdx) {
+        values[channelIdx] = rms[channelIdx].load(std::memory_order_relaxed);
     }
-    return maxVal;
+}
+
+float MeterDecay::getRms(int ch) const {
+    return rms[ch].load(std::memory_order_relaxed);
 }
 
 float panToLinearGain(float gain, bool isLeftChannel) {
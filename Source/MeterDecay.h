@@ -9,20 +9,40 @@
 #pragma once
 
 #include "../JuceLibraryCode/JuceHeader.h"
+#include "SignalProcessing.h"
 
 
+/** Peak and RMS of the last blocks of each channel
+
+ Peak and energy of each block are measured in a single vectorized pass over all the channels.
+ The peak over the window is tracked with a monotonic queue of block peaks per channel, the energy with a running
+ sum, hence push and get are O(1) amortised whatever the window duration. The audio thread publishes the values
+ through atomics, so the GUI never blocks it.
+ */
 class MeterDecay {
 
 public:
 
     MeterDecay(float fs, float duration, float blockSize, int numChannels);
 
+    /** Push a block. Audio thread only. */
     void push(const AudioBuffer<float> &signal);
 
+    /** Scale a block in place by a constant linear gain and push the result, in a single pass. Audio thread only. */
+    void applyGainAndPush(AudioBuffer<float> &signal, float gain);
+
+    /** Peak of all the channels over the window. Any thread. */
     void get(std::vector<float> &meter) const;
 
+    /** Peak of a channel over the window. Any thread. */
     float get(int ch) const;
 
+    /** RMS of all the channels over the window. Any thread. */
+    void getRms(std::vector<float> &meter) const;
+
+    /** RMS of a channel over the window. Any thread. */
+    float getRms(int ch) const;
+
     class Callback {
     public:
         virtual ~Callback() = default;
@@ -30,14 +50,50 @@ public:
         virtual float getMeterValue(int meterId, int channel) const = 0;
 
         virtual void getMeterValues(std::vector<float> &values, int meterId) const = 0;
+
+        virtual void getMeterRmsValues(std::vector<float> &values, int meterId) const = 0;
     };
 
 private:
 
-    std::vector<int> idxs;
-    std::vector<std::vector<float>> minMaxCircularBuffer;
+    /** Block peaks that can still be the maximum of the window, decreasing from front to back. Circular. */
+    struct PeakQueue {
+        std::vector<float> values;
+        std::vector<int64> blockIdxs;
+        int front = 0;
+        int size = 0;
+    };
+
+    /** Add the peak of a block, dropping the values it dominates and the ones out of the window */
+    void pushPeak(PeakQueue &queue, float value);
+
+    /** Add the measured block levels to the window and publish peak and RMS */
+    void pushLevels(int numChannels, int numSamples);
+
+    /** Window length [blocks] */
+    int numBlocks;
+
+    /** Index of the next block */
+    int64 blockIdx = 0;
+
+    std::vector<PeakQueue> queues;
+
+    /** Peak and sum of squares of the last block */
+    std::vector<float> blockPeaks;
+    std::vector<float> blockSumSquares;
+
+    /** Sum of squares of each block in the window, circular, and their running sum per channel */
+    std::vector<std::vector<float>> sumSquaresHistory;
+    std::vector<double> windowSumSquares;
+
+    /** Number of samples of each block in the window, circular, and their running sum */
+    std::vector<int> numSamplesHistory;
+    int64 windowNumSamples = 0;
 
-    SpinLock minMaxCircularBufferLock;
+    /** Peak and RMS over the window of each channel, published by push */
+    std::unique_ptr<std::atomic<float>[]> peaks;
+    std::unique_ptr<std::atomic<float>[]> rms;
+    int numPeaks;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MeterDecay)
 };
@@ -180,6 +180,7 @@ EBeamerAudioProcessorEditor::EBeamerAudioProcessorEditor(EbeamerAudioProcessor &
     //==============================================================================
     
     inputMeter.setCallback(&processor, 0);
+    inputMeter.setPeakHold(INPUT_METER_PEAK_HOLD);
     inputMeter.startTimerHz(INPUT_METER_UPDATE_FREQ);
     addAndMakeVisible(inputMeter);
     
@@ -216,13 +217,32 @@ EBeamerAudioProcessorEditor::EBeamerAudioProcessorEditor(EbeamerAudioProcessor &
     // Configuration selection combo
     configComboLabel.setText("SETUP", NotificationType::dontSendNotification);
     configComboLabel.attachToComponent(&configCombo, true);
-    configCombo.addItemList(micConfigLabels, 10);
+    /** The "config" choices, then the larger layouts, set through the eSticks layout parameters */
+    for (auto configIdx = 0; configIdx < micConfigLabels.size(); configIdx++) {
+        configComboLayouts.push_back(getArrayLayout(static_cast<MicConfig>(configIdx)));
+    }
+    for (auto numRows = 1; numRows <= MAX_NUM_ESTICKS; numRows++) {
+        for (auto sticksPerRow = 1; sticksPerRow * numRows <= MAX_NUM_ESTICKS; sticksPerRow++) {
+            const ArrayLayout layout = {sticksPerRow, numRows};
+            if (getConfigComboIdx(layout) < 0) {
+                configComboLayouts.push_back(layout);
+            }
+        }
+    }
+    for (auto itemIdx = 0; itemIdx < (int) configComboLayouts.size(); itemIdx++) {
+        if (itemIdx == micConfigLabels.size()) {
+            configCombo.addSeparator();
+        }
+        configCombo.addItem(getArrayLayoutLabel(configComboLayouts[itemIdx]), 10 + itemIdx);
+    }
+    configCombo.onChange = [this] { configComboChanged(); };
+    updateConfigCombo();
     addAndMakeVisible(configCombo);
     
-    configComboLabelAttachment.reset(new ComboBoxAttachment(valueTreeState, "config", configCombo));
-    
     /* The editor needs to change its layout when the config changes */
     valueTreeState.addParameterListener("config", this);
+    valueTreeState.addParameterListener("sticksPerRow", this);
+    valueTreeState.addParameterListener("stickRows", this);
     valueTreeState.addParameterListener("frontFacing", this);
     
 }
@@ -256,7 +276,7 @@ void EBeamerAudioProcessorEditor::resized() {
     
     auto sceneArea = area.removeFromTop(SCENE_HEIGHT);
     
-    if (isLinearArray(static_cast<MicConfig>((int)*valueTreeState.getRawParameterValue("config")))){
+    if (isLinearArray(processor.getArrayLayout())){
         steerBeamY1Slider.setVisible(false);
         steerBeamY2Slider.setVisible(false);
         sceneArea.removeFromRight((area.getWidth() - SCENE_WIDTH) / 2);
@@ -353,10 +373,46 @@ void EBeamerAudioProcessorEditor::resized() {
 }
 
 void EBeamerAudioProcessorEditor::parameterChanged (const String & parameterID, float newValue){
-    if (parameterID == "config"){
+    if (parameterID == "config" || parameterID == "sticksPerRow" || parameterID == "stickRows"){
+        updateConfigCombo();
         resized();
     }
     if (parameterID == "frontFacing"){
         scene.resized();
     }
 }
+
+int EBeamerAudioProcessorEditor::getConfigComboIdx(const ArrayLayout &layout) const {
+    for (auto itemIdx = 0; itemIdx < (int) configComboLayouts.size(); itemIdx++) {
+        if (configComboLayouts[itemIdx].numSticksPerRow == layout.numSticksPerRow
+            && configComboLayouts[itemIdx].numRows == layout.numRows) {
+            return itemIdx;
+        }
+    }
+    return -1;
+}
+
+void EBeamerAudioProcessorEditor::updateConfigCombo() {
+    configCombo.setSelectedId(10 + getConfigComboIdx(processor.getArrayLayout()), dontSendNotification);
+}
+
+void EBeamerAudioProcessorEditor::configComboChanged() {
+    const int itemIdx = configCombo.getSelectedId() - 10;
+    if (itemIdx < 0 || itemIdx >= (int) configComboLayouts.size()) {
+        return;
+    }
+    if (itemIdx < micConfigLabels.size()) {
+        setParameter("sticksPerRow", 0);
+        setParameter("config", (float) itemIdx);
+    } else {
+        setParameter("stickRows", (float) configComboLayouts[itemIdx].numRows);
+        setParameter("sticksPerRow", (float) configComboLayouts[itemIdx].numSticksPerRow);
+    }
+}
+
+void EBeamerAudioProcessorEditor::setParameter(const String &parameterID, float value) {
+    auto *param = valueTreeState.getParameter(parameterID);
+    param->beginChangeGesture();
+    param->setValueNotifyingHost(param->convertTo0to1(value));
+    param->endChangeGesture();
+}
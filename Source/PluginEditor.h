@@ -97,7 +97,21 @@ private:
     
     Label configComboLabel;
     ComboBox configCombo;
-    std::unique_ptr<ComboBoxAttachment> configComboLabelAttachment;
+    
+    /** Layout of each item of the combo, the "config" choices first */
+    std::vector<ArrayLayout> configComboLayouts;
+    
+    /** Index of the item of a layout, -1 if none */
+    int getConfigComboIdx(const ArrayLayout &layout) const;
+    
+    /** Select the item of the current layout */
+    void updateConfigCombo();
+    
+    /** Set "config" for the first items, the eSticks layout parameters for the other ones */
+    void configComboChanged();
+    
+    /** Set a parameter to a value in its own range, notifying the host */
+    void setParameter(const String &parameterID, float value);
     
     //==============================================================================
     const std::vector<Colour> beamColours = {Colours::orangered, Colours::royalblue};
@@ -84,17 +84,44 @@ AudioProcessorValueTreeState::ParameterLayout initializeParameters() {
         }
     }
     
+    /** Parameters added later go last, so that hosts keep mapping the existing ones by index */
+    {
+        for (auto beamIdx = 0; beamIdx < NUM_BEAMS; ++beamIdx) {
+            params.push_back(std::make_unique<AudioParameterFloat>("distanceBeam" + String(beamIdx + 1), //tag
+                                                                   "Distance beam" + String(beamIdx + 1), //name
+                                                                   0.0f, //min
+                                                                   10.0f, //max
+                                                                   0.0f //default, far field
+                                                                   ));
+        }
+    }
+    
+    /** eSticks layout beyond the "config" choices, which keep their normalized values */
+    params.push_back(std::make_unique<AudioParameterInt>("sticksPerRow", //tag
+                                                         "eSticks per row", //name
+                                                         0, //min, follow "config"
+                                                         MAX_NUM_ESTICKS, //max
+                                                         0 //default
+                                                         ));
+    
+    params.push_back(std::make_unique<AudioParameterInt>("stickRows", //tag
+                                                         "eStick rows", //name
+                                                         1, //min
+                                                         MAX_NUM_ESTICKS, //max
+                                                         1 //default
+                                                         ));
+    
     return {params.begin(), params.end()};
 }
 
 
 //==============================================================================
-//The default bus layout accommodates for 4 buses of 16 channels each for VST3 mode, one bus with 64 channels for standalone mode.
+//The default bus layout accommodates for 8 buses of 16 channels each for VST3 mode, 4 of them enabled, one bus with 128 channels for standalone mode.
 EbeamerAudioProcessor::EbeamerAudioProcessor()
 : AudioProcessor(JUCEApplication::isStandaloneApp()
                  ?
                  BusesProperties()
-                 .withInput("eSticks", AudioChannelSet::channelSetsWithNumberOfChannels(64)[0])
+                 .withInput("eSticks", AudioChannelSet::channelSetsWithNumberOfChannels(ESTICK_NUM_MICS * MAX_NUM_ESTICKS)[0])
                  .withOutput("Output", AudioChannelSet::stereo(), true)
                  :
                  BusesProperties()
@@ -102,12 +129,20 @@ EbeamerAudioProcessor::EbeamerAudioProcessor()
                  .withInput("eStick#2", AudioChannelSet::ambisonic(3), true)
                  .withInput("eStick#3", AudioChannelSet::ambisonic(3), true)
                  .withInput("eStick#4", AudioChannelSet::ambisonic(3), true)
+                 .withInput("eStick#5", AudioChannelSet::ambisonic(3), false)
+                 .withInput("eStick#6", AudioChannelSet::ambisonic(3), false)
+                 .withInput("eStick#7", AudioChannelSet::ambisonic(3), false)
+                 .withInput("eStick#8", AudioChannelSet::ambisonic(3), false)
                  .withOutput("Output", AudioChannelSet::stereo(), true)
                  ), parameters(*this, nullptr, Identifier("eBeamerParams"), initializeParameters()) {
     
     /** Get parameters pointers */
     configParam = parameters.getRawParameterValue("config");
     parameters.addParameterListener("config", this);
+    sticksPerRowParam = parameters.getRawParameterValue("sticksPerRow");
+    parameters.addParameterListener("sticksPerRow", this);
+    stickRowsParam = parameters.getRawParameterValue("stickRows");
+    parameters.addParameterListener("stickRows", this);
     frontFacingParam = parameters.getRawParameterValue("frontFacing");
     hpfFreqParam = parameters.getRawParameterValue("hpf");
     micGainParam = parameters.getRawParameterValue("gainMic");
@@ -116,6 +151,7 @@ EbeamerAudioProcessor::EbeamerAudioProcessor()
         steerBeamXParam[beamIdx] = parameters.getRawParameterValue("steerBeamX" + String(beamIdx + 1));
         steerBeamYParam[beamIdx] = parameters.getRawParameterValue("steerBeamY" + String(beamIdx + 1));
         widthBeamParam[beamIdx] = parameters.getRawParameterValue("widthBeam" + String(beamIdx + 1));
+        distanceBeamParam[beamIdx] = parameters.getRawParameterValue("distanceBeam" + String(beamIdx + 1));
         panBeamParam[beamIdx] = parameters.getRawParameterValue("panBeam" + String(beamIdx + 1));
         levelBeamParam[beamIdx] = parameters.getRawParameterValue("levelBeam" + String(beamIdx + 1));
         muteBeamParam[beamIdx] = parameters.getRawParameterValue("muteBeam" + String(beamIdx + 1));
@@ -126,10 +162,11 @@ EbeamerAudioProcessor::EbeamerAudioProcessor()
 //==============================================================================
 bool EbeamerAudioProcessor::isBusesLayoutSupported(const BusesLayout &layouts) const {
     if (!JUCEApplication::isStandaloneApp()){
-        // This plug-in supports up to 4 eSticks, for a total amount of 64 channels in input.
+        // This plug-in supports up to 8 eSticks, for a total amount of 128 channels in input.
         // VST3 allows for a maximum of 25 channels per bus.
         // To make things simpler in terms of patching, for VST each input bus counts for at most 16 channels.
-        // This configuration allows REAPER to be configured with a 64 channels track.
+        // The first 4 buses are enabled by default, so that REAPER can be configured with a 64 channels track.
+        // Buses 5 to 8 are enabled by the host for larger arrays, up to the 128 channels of a REAPER track.
         
         for (auto bus : layouts.inputBuses) {
             if (bus.size() > 16) {
@@ -154,6 +191,51 @@ bool EbeamerAudioProcessor::isBusesLayoutSupported(const BusesLayout &layouts) c
 //==============================================================================
 void EbeamerAudioProcessor::prepareToPlay(double sampleRate_, int maximumExpectedSamplesPerBlock_) {
     
+    /** Reconfigurations hold processingLock, hence they are traced as well */
+    ScopedTrace trace(traceRecorder, "prepareToPlay", "message");
+    
+    /** Recorder FIFO for the new stream format. Drains the pending samples to disk, hence out of processingLock */
+    inputRecorder.prepare(getTotalNumInputChannels(), sampleRate_, maximumExpectedSamplesPerBlock_);
+    
+    /** Shared memory ring for the new stream format, created out of processingLock as well.
+     The previous ring is closed first, as they share the file.
+     */
+    std::unique_ptr<SharedBeamRing> newSharedOutput;
+    {
+        GenericScopedLock<SpinLock> lock(processingLock);
+        std::swap(newSharedOutput, sharedOutput);
+    }
+    newSharedOutput = nullptr;
+    newSharedOutput = createSharedOutput(sharedOutputName, sampleRate_, maximumExpectedSamplesPerBlock_);
+    
+    /** Build the new beamformer out of processingLock too, as it reads the geometry file and computes the delay tables.
+     Declared before the lock, the previous beamformer swapped in here is destroyed once the lock is released.
+     */
+    const ArrayLayout layout = getArrayLayout();
+    auto newBeamformer = std::make_unique<Beamformer>(NUM_BEAMS, layout, sampleRate_,
+                                                      maximumExpectedSamplesPerBlock_, beamformerSettings);
+    newBeamformer->setTraceRecorder(traceRecorder);
+    
+    /** Share the input analysis with the instances of the same array processing the same stream format,
+     with spectra of the same size and the same DOA
+     */
+    std::shared_ptr<SharedInputAnalysis> newSharedInput;
+    if (beamformerSettings.arrayId.isNotEmpty()) {
+        const String key = beamformerSettings.arrayId + "/" + String(layout.numSticksPerRow) + "x" +
+                           String(layout.numRows) + "/" + String(sampleRate_) + "/" +
+                           String(maximumExpectedSamplesPerBlock_) + "/" + String(beamformerSettings.doaGridX) + "x" +
+                           String(beamformerSettings.doaGridY) + "/" + beamformerSettings.geometryFile + "/" +
+                           String(beamformerSettings.nearfieldMinDistance) + "/" + String(newBeamformer->getNumMics()) +
+                           "x" + String(newBeamformer->getFftSize());
+        newSharedInput = sharedInputRegistry->join(key, newBeamformer.get());
+        if (!newBeamformer->setSharedInput(newSharedInput.get())) {
+            jassertfalse;
+            sharedInputRegistry->leave(newSharedInput, newBeamformer.get());
+            newSharedInput = nullptr;
+        }
+    }
+    leaveSharedInput();
+    
     GenericScopedLock<SpinLock> lock(processingLock);
     
     sampleRate = sampleRate_;
@@ -176,8 +258,15 @@ void EbeamerAudioProcessor::prepareToPlay(double sampleRate_, int maximumExpecte
     iirHPFfilters.resize(numActiveInputChannels);
     prevHpfFreq = 0;
     
-    /** Initialize the beamformer */
-    beamformer = std::make_unique<Beamformer>(NUM_BEAMS, static_cast<MicConfig>((int) *configParam),sampleRate, maximumExpectedSamplesPerBlock);
+    /** Swap in the beamformer */
+    std::swap(beamformer, newBeamformer);
+    std::swap(sharedInput, newSharedInput);
+    
+    /** Profile the new configuration from scratch */
+    profiler.reset();
+    beamformer->setProfiler(&profiler);
+    
+    sharedOutput = std::move(newSharedOutput);
     
     /** Initialize beams' buffer  */
     beamBuffer.setSize(NUM_BEAMS, maximumExpectedSamplesPerBlock);
@@ -197,13 +286,17 @@ void EbeamerAudioProcessor::prepareToPlay(double sampleRate_, int maximumExpecte
     
     resourcesAllocated = true;
     
-    /** Time constants */
-    loadAlpha = 1 - exp(-(maximumExpectedSamplesPerBlock / sampleRate) / loadTimeConst);
-    
 }
 
 void EbeamerAudioProcessor::releaseResources() {
     
+    ScopedTrace trace(traceRecorder, "releaseResources", "message");
+    
+    /** Destroyed once the lock is released, as stopping the beamformer threads takes time */
+    std::unique_ptr<Beamformer> oldBeamformer;
+    std::shared_ptr<SharedInputAnalysis> oldSharedInput;
+    leaveSharedInput();
+    
     GenericScopedLock<SpinLock> lock(processingLock);
     
     resourcesAllocated = false;
@@ -215,7 +308,14 @@ void EbeamerAudioProcessor::releaseResources() {
     iirHPFfilters.clear();
     
     /** Clear the Beamformer */
-    beamformer.reset();
+    std::swap(oldBeamformer, beamformer);
+    std::swap(oldSharedInput, sharedInput);
+}
+
+void EbeamerAudioProcessor::leaveSharedInput() {
+    if (sharedInput != nullptr) {
+        sharedInputRegistry->leave(sharedInput, beamformer.get());
+    }
 }
 
 bool EbeamerAudioProcessor::insertCCParamMapping(const MidiCC &cc, const String &param) {
@@ -296,6 +396,8 @@ void EbeamerAudioProcessor::processBlock(AudioBuffer<float> &buffer, MidiBuffer
     
     const auto startTick = Time::getHighResolutionTicks();
     
+    traceRecorder->begin("processBlock", "audio");
+    
     GenericScopedLock<SpinLock> lock(processingLock);
     
     processMidi(midiMessages);
@@ -303,35 +405,52 @@ void EbeamerAudioProcessor::processBlock(AudioBuffer<float> &buffer, MidiBuffer
     /** If resources are not allocated this is an out-of-order request */
     if (!resourcesAllocated) {
         jassertfalse;
+        traceRecorder->end("processBlock", "audio");
         return;
     }
     
     
     ScopedNoDenormals noDenormals;
     
-    /**Apply input gain directly on input buffer  */
-    micGain.setGainDecibels(*micGainParam);
-    {
-        auto block = juce::dsp::AudioBlock<float>(buffer).getSubsetChannelBlock(0, numActiveInputChannels);
-        auto context = juce::dsp::ProcessContextReplacing<float>(block);
-        micGain.process(context);
-    }
-    
-    // Mic meter
-    inputMeterDecay->push(buffer);
+    /** Capture the raw input, before any processing */
+    inputRecorder.push(buffer);
     
-    /** Renew IIR coefficient if cut frequency changed */
-    if (prevHpfFreq != (bool) *hpfFreqParam) {
-        iirCoeffHPF = IIRCoefficients::makeHighPass(sampleRate, *hpfFreqParam);
-        prevHpfFreq = *hpfFreqParam;
-        for (auto &iirHPFfilter : iirHPFfilters) {
-            iirHPFfilter.setCoefficients(iirCoeffHPF);
+    /**Apply input gain directly on input buffer and meter the result  */
+    micGain.setGainDecibels(*micGainParam);
+    if (micGain.isSmoothing()) {
+        /** Per-sample gain ramp, separate gain and metering passes */
+        {
+            ScopedStageTimer timer(&profiler, STAGE_INPUT_CONDITIONING);
+            auto block = juce::dsp::AudioBlock<float>(buffer).getSubsetChannelBlock(0, numActiveInputChannels);
+            auto context = juce::dsp::ProcessContextReplacing<float>(block);
+            micGain.process(context);
+        }
+        {
+            ScopedStageTimer timer(&profiler, STAGE_METERING);
+            inputMeterDecay->push(buffer);
         }
+    } else {
+        /** Constant gain, scale and meter in a single pass */
+        ScopedStageTimer timer(&profiler, STAGE_INPUT_CONDITIONING);
+        inputMeterDecay->applyGainAndPush(buffer, micGain.getGainLinear());
     }
     
-    /**Apply HPF directly on input buffer  */
-    for (auto inChannel = 0; inChannel < numActiveInputChannels; ++inChannel) {
-        iirHPFfilters[inChannel].processSamples(buffer.getWritePointer(inChannel), buffer.getNumSamples());
+    {
+        ScopedStageTimer timer(&profiler, STAGE_INPUT_CONDITIONING);
+        
+        /** Renew IIR coefficient if cut frequency changed */
+        if (prevHpfFreq != (bool) *hpfFreqParam) {
+            iirCoeffHPF = IIRCoefficients::makeHighPass(sampleRate, *hpfFreqParam);
+            prevHpfFreq = *hpfFreqParam;
+            for (auto &iirHPFfilter : iirHPFfilters) {
+                iirHPFfilter.setCoefficients(iirCoeffHPF);
+            }
+        }
+        
+        /**Apply HPF directly on input buffer  */
+        for (auto inChannel = 0; inChannel < numActiveInputChannels; ++inChannel) {
+            iirHPFfilters[inChannel].processSamples(buffer.getWritePointer(inChannel), buffer.getNumSamples());
+        }
     }
     
     /** Set beams parameters */
@@ -339,7 +458,7 @@ void EbeamerAudioProcessor::processBlock(AudioBuffer<float> &buffer, MidiBuffer
         float beamDoaX = *steerBeamXParam[beamIdx];
         float beamDoaY = -(*steerBeamYParam[beamIdx]); //GUI and Beamforming use opposite vertical conventions
         beamDoaX = *frontFacingParam ? -beamDoaX : beamDoaX;
-        BeamParameters beamParams = {beamDoaX,beamDoaY, *widthBeamParam[beamIdx]};
+        BeamParameters beamParams = {beamDoaX,beamDoaY, *widthBeamParam[beamIdx], *distanceBeamParam[beamIdx]};
         beamformer->setBeamParameters(beamIdx, beamParams);
     }
     
@@ -347,42 +466,66 @@ void EbeamerAudioProcessor::processBlock(AudioBuffer<float> &buffer, MidiBuffer
     beamformer->processBlock(buffer);
     
     /** Retrieve beamformer outputs */
-    beamformer->getBeams(beamBuffer);
-    
-    /** Apply beams mute and volume */
-    for (auto beamIdx = 0; beamIdx < NUM_BEAMS; ++beamIdx) {
-        if ((bool) *muteBeamParam[beamIdx] == false) {
-            beamGain[beamIdx].setGainDecibels(*levelBeamParam[beamIdx]);
-        } else {
-            beamGain[beamIdx].setGainLinear(0);
+    {
+        ScopedStageTimer timer(&profiler, STAGE_OUTPUT_MIX);
+        beamformer->getBeams(beamBuffer);
+        
+        /** Apply beams mute and volume */
+        for (auto beamIdx = 0; beamIdx < NUM_BEAMS; ++beamIdx) {
+            if ((bool) *muteBeamParam[beamIdx] == false) {
+                beamGain[beamIdx].setGainDecibels(*levelBeamParam[beamIdx]);
+            } else {
+                beamGain[beamIdx].setGainLinear(0);
+            }
+            auto block = dsp::AudioBlock<float>(beamBuffer).getSubsetChannelBlock(beamIdx, 1).getSubBlock(0,
+                                                                                                          buffer.getNumSamples());
+            auto contextToUse = dsp::ProcessContextReplacing<float>(block);
+            beamGain[beamIdx].process(contextToUse);
         }
-        auto block = dsp::AudioBlock<float>(beamBuffer).getSubsetChannelBlock(beamIdx, 1).getSubBlock(0,
-                                                                                                      buffer.getNumSamples());
-        auto contextToUse = dsp::ProcessContextReplacing<float>(block);
-        beamGain[beamIdx].process(contextToUse);
     }
     
     /** Measure beam output volume */
-    beamMeterDecay->push(beamBuffer);
+    {
+        ScopedStageTimer timer(&profiler, STAGE_METERING);
+        beamMeterDecay->push(beamBuffer);
+    }
     
-    /** Clear buffer */
-    buffer.clear();
+    /** Publish beams to local consumers */
+    if (sharedOutput != nullptr) {
+        ScopedStageTimer timer(&profiler, STAGE_OUTPUT_MIX);
+        sharedOutput->write(beamBuffer, buffer.getNumSamples());
+    }
     
-    /** Sum beams in output channels */
-    for (int outChannel = 0; outChannel < numActiveOutputChannels; ++outChannel) {
-        /** Sum the contributes from each beam */
-        for (int beamIdx = 0; beamIdx < NUM_BEAMS; ++beamIdx) {
-            auto channelBeamGain = panToLinearGain((float) *panBeamParam[beamIdx], outChannel == 0);
-            buffer.addFrom(outChannel, 0, beamBuffer, beamIdx, 0, buffer.getNumSamples(), channelBeamGain);
+    {
+        ScopedStageTimer timer(&profiler, STAGE_OUTPUT_MIX);
+        
+        /** Clear buffer */
+        buffer.clear();
+        
+        /** Sum beams in output channels */
+        for (int outChannel = 0; outChannel < numActiveOutputChannels; ++outChannel) {
+            /** Sum the contributes from each beam */
+            for (int beamIdx = 0; beamIdx < NUM_BEAMS; ++beamIdx) {
+                auto channelBeamGain = panToLinearGain((float) *panBeamParam[beamIdx], outChannel == 0);
+                buffer.addFrom(outChannel, 0, beamBuffer, beamIdx, 0, buffer.getNumSamples(), channelBeamGain);
+            }
         }
     }
     
-    /** Update load */
+    /** Update load, relative to the duration of this block */
     {
+        const float blockDuration = buffer.getNumSamples() / sampleRate;
         const float elapsedTime = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - startTick);
-        const float curLoad = elapsedTime / (maximumExpectedSamplesPerBlock / sampleRate);
+        profiler.finishBlock(elapsedTime, blockDuration);
+        const float curLoad = blockDuration > 0 ? elapsedTime / blockDuration : 0;
+        traceRecorder->end("processBlock", "audio");
+        if (curLoad > deadlineFraction) {
+            traceRecorder->triggerSnapshot();
+        }
+        const float loadAlpha = 1 - exp(-blockDuration / loadTimeConst);
         GenericScopedLock<SpinLock> lock(loadLock);
         load = (load * (1 - loadAlpha)) + (curLoad * loadAlpha);
+        beamformer->setAudioLoad(load);
     }
     
 }
@@ -400,6 +543,17 @@ void EbeamerAudioProcessor::getMeterValues(std::vector<float> &meter, int meterI
     }
 }
 
+void EbeamerAudioProcessor::getMeterRmsValues(std::vector<float> &meter, int meterId) const {
+    switch (meterId) {
+        case 0:
+            inputMeterDecay->getRms(meter);
+            break;
+        case 1:
+            beamMeterDecay->getRms(meter);
+            break;
+    }
+}
+
 float EbeamerAudioProcessor::getMeterValue(int meterId, int channel) const {
     switch (meterId) {
         case 0:
@@ -413,22 +567,46 @@ float EbeamerAudioProcessor::getMeterValue(int meterId, int channel) const {
 //==============================================================================
 
 void EbeamerAudioProcessor::parameterChanged(const String &parameterID, float newValue) {
-    if (parameterID == "config") {
-        setMicConfig(static_cast<MicConfig>((int) (newValue)));
+    if (parameterID == "config" || parameterID == "sticksPerRow" || parameterID == "stickRows") {
+        updateArrayLayout();
     }
 }
 
 //==============================================================================
-void EbeamerAudioProcessor::setMicConfig(const MicConfig &mc) {
+void EbeamerAudioProcessor::updateArrayLayout() {
     prepareToPlay(sampleRate, maximumExpectedSamplesPerBlock);
 }
 
+ArrayLayout EbeamerAudioProcessor::getArrayLayout() const {
+    const int sticksPerRow = (int) *sticksPerRowParam;
+    if (sticksPerRow > 0) {
+        /** Rows beyond MAX_NUM_ESTICKS eSticks in total are dropped */
+        return {sticksPerRow, jlimit(1, MAX_NUM_ESTICKS / sticksPerRow, (int) *stickRowsParam)};
+    }
+    return ::getArrayLayout(static_cast<MicConfig>((int) *configParam));
+}
+
 //==============================================================================
 float EbeamerAudioProcessor::getCpuLoad() const {
     GenericScopedLock<SpinLock> lock(loadLock);
     return load;
 }
 
+String EbeamerAudioProcessor::getProfilingReport() const {
+    return profiler.getReport();
+}
+
+const StageProfiler &EbeamerAudioProcessor::getProfiler() const {
+    return profiler;
+}
+
+float EbeamerAudioProcessor::getDoaUpdateTime() const {
+    if (beamformer != nullptr){
+        return beamformer->getDoaUpdateTime();
+    }
+    return 0;
+}
+
 //==============================================================================
 void EbeamerAudioProcessor::getStateInformation(MemoryBlock &destData) {
     /** Root XML */
@@ -446,6 +624,21 @@ void EbeamerAudioProcessor::getStateInformation(MemoryBlock &destData) {
         el->setAttribute("channel", m.second.channel);
         el->setAttribute("number", m.second.number);
     }
+    
+    /** Save Beamformer settings */
+    auto xmlSettings = xml->createNewChildElement("eBeamerSettings");
+    xmlSettings->setAttribute("doaNumThreads", beamformerSettings.doaNumThreads);
+    xmlSettings->setAttribute("renderNumThreads", beamformerSettings.renderNumThreads);
+    xmlSettings->setAttribute("doaCoarseStep", beamformerSettings.doaCoarseStep);
+    xmlSettings->setAttribute("doaNumPeaks", beamformerSettings.doaNumPeaks);
+    xmlSettings->setAttribute("doaGridX", beamformerSettings.doaGridX);
+    xmlSettings->setAttribute("doaGridY", beamformerSettings.doaGridY);
+    xmlSettings->setAttribute("doaCpuBudget", beamformerSettings.doaCpuBudget);
+    xmlSettings->setAttribute("arrayId", beamformerSettings.arrayId);
+    xmlSettings->setAttribute("geometryFile", beamformerSettings.geometryFile);
+    xmlSettings->setAttribute("nearfieldMinDistance", beamformerSettings.nearfieldMinDistance);
+    xmlSettings->setAttribute("sharedOutput", sharedOutputName);
+    
     copyXmlToBinary(*xml, destData);
 }
 
@@ -470,18 +663,46 @@ void EbeamerAudioProcessor::setStateInformation(const void *data, int sizeInByte
                         int number = e->getIntAttribute("number");
                         insertCCParamMapping({channel, number}, tag);
                     }
+                } else if (rootElement->hasTagName("eBeamerSettings")) {
+                    /** Load Beamformer settings */
+                    BeamformerSettings newSettings;
+                    newSettings.doaNumThreads = rootElement->getIntAttribute("doaNumThreads", newSettings.doaNumThreads);
+                    newSettings.renderNumThreads = rootElement->getIntAttribute("renderNumThreads", newSettings.renderNumThreads);
+                    newSettings.doaCoarseStep = rootElement->getIntAttribute("doaCoarseStep", newSettings.doaCoarseStep);
+                    newSettings.doaNumPeaks = rootElement->getIntAttribute("doaNumPeaks", newSettings.doaNumPeaks);
+                    newSettings.doaGridX = rootElement->getIntAttribute("doaGridX", newSettings.doaGridX);
+                    newSettings.doaGridY = rootElement->getIntAttribute("doaGridY", newSettings.doaGridY);
+                    newSettings.doaCpuBudget = rootElement->getDoubleAttribute("doaCpuBudget", newSettings.doaCpuBudget);
+                    newSettings.arrayId = rootElement->getStringAttribute("arrayId", newSettings.arrayId);
+                    newSettings.geometryFile = rootElement->getStringAttribute("geometryFile", newSettings.geometryFile);
+                    newSettings.nearfieldMinDistance = rootElement->getDoubleAttribute("nearfieldMinDistance", newSettings.nearfieldMinDistance);
+                    setBeamformerSettings(newSettings);
+                    const String newSharedOutputName = rootElement->getStringAttribute("sharedOutput");
+                    if (newSharedOutputName != sharedOutputName) {
+                        if (newSharedOutputName.isEmpty())
+                            stopSharedOutput();
+                        else
+                            startSharedOutput(newSharedOutputName);
+                    }
                 }
             }
         }
     }
 }
 
-//==============================================================================
-
-const std::atomic<float> *EbeamerAudioProcessor::getConfigParam() const {
-    return parameters.getRawParameterValue("config");
+void EbeamerAudioProcessor::setBeamformerSettings(const BeamformerSettings &newSettings) {
+    if (!(newSettings != beamformerSettings)) {
+        return;
+    }
+    beamformerSettings = newSettings;
+    /** Settings are applied when the Beamformer is created */
+    if (resourcesAllocated) {
+        prepareToPlay(sampleRate, maximumExpectedSamplesPerBlock);
+    }
 }
 
+//==============================================================================
+
 const std::atomic<float> *EbeamerAudioProcessor::getFrontFacingParam() const {
     return parameters.getRawParameterValue("frontFacing");
 }
@@ -510,15 +731,65 @@ void EbeamerAudioProcessor::setBeamSteerY(int idx, float newVal){
     parameters.getParameterAsValue("steerBeamY"+String(idx+1)).setValue(newVal);
 }
 
-void EbeamerAudioProcessor::getDoaEnergy(Mtx &energy) const {
-    if (beamformer != nullptr){
-        beamformer->getDoaEnergy(energy);
+void EbeamerAudioProcessor::getDoaMap(Mtx &energy, std::vector<DoaPeak> &peaks) const {
+    if (sharedInput != nullptr) {
+        sharedInput->getDoaMap(energy, peaks);
+    } else if (beamformer != nullptr){
+        beamformer->getDoaMap(energy, peaks);
     }
 }
 
+bool EbeamerAudioProcessor::startRecording(const File &folder) {
+    return inputRecorder.start(folder);
+}
+
+void EbeamerAudioProcessor::stopRecording() {
+    inputRecorder.stop();
+}
+
+const InputRecorder &EbeamerAudioProcessor::getInputRecorder() const {
+    return inputRecorder;
+}
+
+bool EbeamerAudioProcessor::startSharedOutput(const String &name) {
+    stopSharedOutput();
+    /** The file is created and zero-filled without holding processingLock */
+    auto ring = resourcesAllocated ? createSharedOutput(name, sampleRate, maximumExpectedSamplesPerBlock) : nullptr;
+    const bool success = ring != nullptr || !resourcesAllocated;
+    GenericScopedLock<SpinLock> lock(processingLock);
+    sharedOutputName = name;
+    sharedOutput = std::move(ring);
+    return success;
+}
+
+void EbeamerAudioProcessor::stopSharedOutput() {
+    std::unique_ptr<SharedBeamRing> ring;
+    {
+        GenericScopedLock<SpinLock> lock(processingLock);
+        sharedOutputName = {};
+        std::swap(ring, sharedOutput);
+    }
+}
+
+File EbeamerAudioProcessor::getSharedOutputFile() const {
+    return sharedOutput != nullptr ? sharedOutput->getFile() : File();
+}
+
+std::unique_ptr<SharedBeamRing> EbeamerAudioProcessor::createSharedOutput(const String &name, double fs,
+                                                                          int maximumBlockSize) const {
+    if (name.isEmpty())
+        return nullptr;
+    const double seconds = jmax(sharedOutputSeconds, 2.0 * maximumBlockSize / fs);
+    auto ring = std::make_unique<SharedBeamRing>(SharedBeamRing::getFileForName(name), NUM_BEAMS, fs, seconds);
+    if (!ring->isValid())
+        return nullptr;
+    return ring;
+}
+
 //==============================================================================
 // Unchanged JUCE default functions
 EbeamerAudioProcessor::~EbeamerAudioProcessor() {
+    leaveSharedInput();
 }
 
 const String EbeamerAudioProcessor::getName() const {
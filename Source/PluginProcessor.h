@@ -13,6 +13,9 @@
 #include "Beamformer.h"
 #include "CpuLoadComp.h"
 #include "SceneComp.h"
+#include "InputRecorder.h"
+#include "SharedInputAnalysis.h"
+#include "SharedBeamRing.h"
 
 //==============================================================================
 
@@ -74,10 +77,20 @@ public:
     
     float getMeterValue(int meterId, int channel) const override;
     
+    void getMeterRmsValues(std::vector<float> &meter, int meterId) const override;
+    
     //==============================================================================
     // CpuLoadComp Callback
     float getCpuLoad() const override;
     
+    float getDoaUpdateTime() const override;
+    
+    String getProfilingReport() const override;
+    
+    //==============================================================================
+    /** Per-stage timing statistics of processBlock */
+    const StageProfiler &getProfiler() const;
+    
     //==============================================================================
     // MidiCC Callback
     /** Start learning the specified parameter */
@@ -97,7 +110,8 @@ public:
     
     //==============================================================================
     //SceneComponent Callback
-    const std::atomic<float> *getConfigParam() const override;
+    /** eSticks layout, from "sticksPerRow" and "stickRows" if sticksPerRow is not 0, from "config" otherwise */
+    ArrayLayout getArrayLayout() const override;
     
     const std::atomic<float> *getFrontFacingParam() const override;
     
@@ -113,7 +127,31 @@ public:
     
     void setBeamSteerY(int idx, float newVal) override;
     
-    void getDoaEnergy(Mtx &energy) const override;
+    void getDoaMap(Mtx &energy, std::vector<DoaPeak> &peaks) const override;
+    
+    //==============================================================================
+    /** Start capturing the raw microphone signals to a new file in folder. Message thread only. */
+    bool startRecording(const File &folder);
+    
+    /** Stop capturing the microphone signals. Message thread only. */
+    void stopRecording();
+    
+    /** Recorder of the raw microphone signals */
+    const InputRecorder &getInputRecorder() const;
+    
+    //==============================================================================
+    /** Publish the beams, after level and mute, to local processes through the shared memory ring name.
+     
+     Message thread only. The ring is re-created at every prepareToPlay. Stored with the plugin state.
+     @return: false if the ring cannot be created, for example when another instance publishes the same name
+     */
+    bool startSharedOutput(const String &name);
+    
+    /** Stop publishing the beams in shared memory. Message thread only. */
+    void stopSharedOutput();
+    
+    /** File backing the shared memory ring, File() if not publishing */
+    File getSharedOutputFile() const;
     
 private:
     //==============================================================================
@@ -145,6 +183,9 @@ private:
     /** The active beamformer */
     std::unique_ptr<Beamformer> beamformer;
     
+    /** Deployment-specific beamformer settings, stored with the plugin state */
+    BeamformerSettings beamformerSettings;
+    
     //==============================================================================
     // Meters
     std::unique_ptr<MeterDecay> inputMeterDecay;
@@ -174,8 +215,24 @@ private:
     int maximumExpectedSamplesPerBlock = 4096;
     
     //==============================================================================
-    /** Set a new microphone configuration */
-    void setMicConfig(const MicConfig &mc);
+    /** Re-create the beamformer for a new eSticks layout */
+    void updateArrayLayout();
+    
+    /** Set new beamformer settings, re-creating the beamformer if needed */
+    void setBeamformerSettings(const BeamformerSettings &newSettings);
+    
+    //==============================================================================
+    /** Input analyses shared by the instances of the same array, process-wide */
+    SharedResourcePointer<SharedInputRegistry> sharedInputRegistry;
+    
+    /** Input analysis shared with the other instances of beamformerSettings.arrayId. nullptr if not shared */
+    std::shared_ptr<SharedInputAnalysis> sharedInput;
+    
+    /** Remove the current beamformer from the group sharing its input analysis.
+     
+     It stops feeding the shared DOA but it may keep processing, with its group, until it is replaced.
+     */
+    void leaveSharedInput();
     
     //==============================================================================
     
@@ -183,11 +240,35 @@ private:
     float load = 0;
     /** Load time constant [s] */
     const float loadTimeConst = 1;
-    /** Load update factor (the higher the faster the update) */
-    float loadAlpha = 1;
     /** Load lock */
     SpinLock loadLock;
     
+    /** Per-stage timing of processBlock */
+    StageProfiler profiler;
+    
+    /** Event trace shared by all instances, dumped when a block misses its deadline */
+    SharedResourcePointer<TraceRecorder> traceRecorder;
+    
+    /** Fraction of the block duration after which a block is considered late */
+    const float deadlineFraction = 1;
+    
+    //==============================================================================
+    /** Raw microphone signals recorder */
+    InputRecorder inputRecorder;
+    
+    //==============================================================================
+    /** Name of the shared memory ring the beams are published to, empty if disabled */
+    String sharedOutputName;
+    
+    /** Shared memory ring of the beams, nullptr if disabled */
+    std::unique_ptr<SharedBeamRing> sharedOutput;
+    
+    /** Duration of the shared memory ring [s] */
+    const double sharedOutputSeconds = 2;
+    
+    /** Create the shared memory ring name for a stream format. nullptr if it cannot be created. Creates the file, do not hold processingLock */
+    std::unique_ptr<SharedBeamRing> createSharedOutput(const String &name, double fs, int maximumBlockSize) const;
+    
     //==============================================================================
     
     /** Processor parameters tree */
@@ -198,6 +279,8 @@ private:
     std::atomic<float> *steerBeamXParam[NUM_BEAMS];
     std::atomic<float> *steerBeamYParam[NUM_BEAMS];
     std::atomic<float> *widthBeamParam[NUM_BEAMS];
+    /** Focus distance, effective only when the beamformer settings enable near-field beams */
+    std::atomic<float> *distanceBeamParam[NUM_BEAMS];
     std::atomic<float> *panBeamParam[NUM_BEAMS];
     std::atomic<float> *levelBeamParam[NUM_BEAMS];
     std::atomic<float> *muteBeamParam[NUM_BEAMS];
@@ -205,6 +288,8 @@ private:
     std::atomic<float> *hpfFreqParam;
     std::atomic<float> *frontFacingParam;
     std::atomic<float> *configParam;
+    std::atomic<float> *sticksPerRowParam;
+    std::atomic<float> *stickRowsParam;
     
     void parameterChanged(const String &parameterID, float newValue) override;
     
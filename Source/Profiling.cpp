@@ -0,0 +1,141 @@
+/*
+ Hot-path timing instrumentation
+ 
+ Authors:
+ Luca Bondi (luca.bondi@polimi.it)
+*/
+
+#include "Profiling.h"
+
+StageHistogram::StageHistogram() {
+    reset();
+}
+
+int StageHistogram::getBucket(float duration) {
+    const float durationUs = duration * 1e6f;
+    if (durationUs < 1) {
+        return 0;
+    }
+    return jmin(numBuckets - 1, 1 + (int) (std::log2(durationUs) * bucketsPerOctave));
+}
+
+float StageHistogram::getBucketUpperBound(int bucketIdx) {
+    return std::exp2((float) bucketIdx / bucketsPerOctave) * 1e-6f;
+}
+
+void StageHistogram::record(float duration) {
+    counts[getBucket(duration)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    
+    float prevMax = maxDuration.load(std::memory_order_relaxed);
+    while (duration > prevMax && !maxDuration.compare_exchange_weak(prevMax, duration, std::memory_order_relaxed)) {
+    }
+}
+
+float StageHistogram::getPercentile(float p) const {
+    const uint32 total = getCount();
+    if (total == 0) {
+        return 0;
+    }
+    const auto target = (uint32) std::ceil(jlimit(0.f, 100.f, p) / 100 * total);
+    uint32 cumulative = 0;
+    for (auto bucketIdx = 0; bucketIdx < numBuckets; bucketIdx++) {
+        cumulative += counts[bucketIdx].load(std::memory_order_relaxed);
+        if (cumulative >= jmax(1u, target)) {
+            /** The bucket upper bound can exceed the longest duration recorded */
+            return jmin(getBucketUpperBound(bucketIdx), getMax());
+        }
+    }
+    return getMax();
+}
+
+float StageHistogram::getMax() const {
+    return maxDuration.load(std::memory_order_relaxed);
+}
+
+uint32 StageHistogram::getCount() const {
+    return count.load(std::memory_order_relaxed);
+}
+
+void StageHistogram::reset() {
+    for (auto &c : counts) {
+        c.store(0, std::memory_order_relaxed);
+    }
+    count.store(0, std::memory_order_relaxed);
+    maxDuration.store(0, std::memory_order_relaxed);
+}
+
+//==============================================================================
+
+StageProfiler::StageProfiler() {
+    for (auto &t : blockTicks) {
+        t = 0;
+    }
+}
+
+void StageProfiler::addTime(ProcessingStage stage, int64 ticks) {
+    blockTicks[stage] += ticks;
+}
+
+void StageProfiler::finishBlock(float blockTime, float blockDuration) {
+    int64 instrumentedTicks = 0;
+    for (auto stageIdx = 0; stageIdx < NUM_STAGES; stageIdx++) {
+        stageHistograms[stageIdx].record(Time::highResolutionTicksToSeconds(blockTicks[stageIdx]));
+        instrumentedTicks += blockTicks[stageIdx];
+        blockTicks[stageIdx] = 0;
+    }
+    instrumentedHistogram.record(Time::highResolutionTicksToSeconds(instrumentedTicks));
+    blockHistogram.record(blockTime);
+    if (blockDuration > 0) {
+        loadHistogram.record(blockTime / blockDuration);
+    }
+}
+
+StageProfiler::StageStats StageProfiler::getStats(const StageHistogram &h) {
+    return {h.getPercentile(50), h.getPercentile(99), h.getMax(), h.getCount()};
+}
+
+StageProfiler::StageStats StageProfiler::getStats(ProcessingStage stage) const {
+    return getStats(stageHistograms[stage]);
+}
+
+StageProfiler::StageStats StageProfiler::getBlockStats() const {
+    return getStats(blockHistogram);
+}
+
+StageProfiler::StageStats StageProfiler::getInstrumentedStats() const {
+    return getStats(instrumentedHistogram);
+}
+
+StageProfiler::StageStats StageProfiler::getLoadStats() const {
+    return getStats(loadHistogram);
+}
+
+String StageProfiler::getReport() const {
+    auto formatStats = [](const String &label, const StageStats &stats) {
+        return label + ": p50 " + String(roundToInt(stats.p50 * 1e6)) + " us, p99 " +
+               String(roundToInt(stats.p99 * 1e6)) + " us, max " + String(roundToInt(stats.max * 1e6)) + " us";
+    };
+    
+    StringArray lines;
+    for (auto stageIdx = 0; stageIdx < NUM_STAGES; stageIdx++) {
+        lines.add(formatStats(processingStageLabels[stageIdx], getStats((ProcessingStage) stageIdx)));
+    }
+    lines.add(formatStats("Instrumented", getInstrumentedStats()));
+    lines.add(formatStats("Block", getBlockStats()));
+    
+    const auto load = getLoadStats();
+    lines.add("Load: p50 " + String(roundToInt(load.p50 * 100)) + "%, p99 " + String(roundToInt(load.p99 * 100)) +
+              "%, max " + String(roundToInt(load.max * 100)) + "% over " + String(load.count) + " blocks");
+    
+    return lines.joinIntoString("\n");
+}
+
+void StageProfiler::reset() {
+    for (auto &h : stageHistograms) {
+        h.reset();
+    }
+    blockHistogram.reset();
+    instrumentedHistogram.reset();
+    loadHistogram.reset();
+}
@@ -0,0 +1,181 @@
+/*
+ Hot-path timing instrumentation
+ 
+ Authors:
+ Luca Bondi (luca.bondi@polimi.it)
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+/** Stages of the audio processing hot path */
+typedef enum {
+    STAGE_INPUT_CONDITIONING,
+    STAGE_FIR_DESIGN,
+    STAGE_FORWARD_FFT,
+    STAGE_MAC,
+    STAGE_INVERSE_FFT,
+    STAGE_OUTPUT_MIX,
+    STAGE_METERING,
+    NUM_STAGES,
+} ProcessingStage;
+
+/** Processing stages labels */
+const StringArray processingStageLabels({
+                                                "Input conditioning",
+                                                "FIR design",
+                                                "Forward FFT",
+                                                "MAC",
+                                                "Inverse FFT",
+                                                "Output mix",
+                                                "Metering",
+                                        });
+
+//==============================================================================
+
+/** Histogram of durations with fixed, logarithmically spaced buckets.
+ 
+ Recording is wait-free and allocation-free, reading can happen concurrently from any thread.
+ */
+class StageHistogram {
+    
+public:
+    
+    StageHistogram();
+    
+    /** Number of buckets per octave */
+    static constexpr int bucketsPerOctave = 4;
+    
+    /** Number of buckets. The first one collects durations below 1 us, the last one everything above ~1 s */
+    static constexpr int numBuckets = 2 + 20 * bucketsPerOctave;
+    
+    /** Record a duration [s] */
+    void record(float duration);
+    
+    /** Upper bound of the bucket containing the p-th percentile [s]
+     
+     @param p: percentile, from 0 to 100
+     */
+    float getPercentile(float p) const;
+    
+    /** Longest recorded duration [s] */
+    float getMax() const;
+    
+    /** Number of recorded durations */
+    uint32 getCount() const;
+    
+    /** Clear the histogram. Durations recorded meanwhile might be partially lost. */
+    void reset();
+    
+private:
+    
+    /** Bucket index of a duration [s] */
+    static int getBucket(float duration);
+    
+    /** Upper bound of a bucket [s] */
+    static float getBucketUpperBound(int bucketIdx);
+    
+    std::atomic<uint32> counts[numBuckets];
+    std::atomic<uint32> count;
+    std::atomic<float> maxDuration;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (StageHistogram)
+};
+
+//==============================================================================
+
+/** Per-stage timing of the audio thread
+ 
+ Stages can be timed several times per block, their durations are summed and recorded once per block.
+ addTime and finishBlock are meant to be called from the audio thread only, everything else from any thread.
+ */
+class StageProfiler {
+    
+public:
+    
+    StageProfiler();
+    
+    /** Statistics of a stage [s] */
+    typedef struct {
+        float p50;
+        float p99;
+        float max;
+        uint32 count;
+    } StageStats;
+    
+    /** Add time spent in a stage during the current block [ticks] */
+    void addTime(ProcessingStage stage, int64 ticks);
+    
+    /** Record the stages of the current block and start a new one
+     
+     @param blockTime: wall time of the whole block processing, including what is outside of the stages [s]
+     @param blockDuration: duration of the audio in the block [s]
+     */
+    void finishBlock(float blockTime, float blockDuration);
+    
+    /** Statistics of a stage */
+    StageStats getStats(ProcessingStage stage) const;
+    
+    /** Statistics of the whole block, wall time */
+    StageStats getBlockStats() const;
+    
+    /** Statistics of the sum of the stages of each block. The gap to the block is the time outside of the stages */
+    StageStats getInstrumentedStats() const;
+    
+    /** Statistics of the load of each block, i.e. wall time over block duration */
+    StageStats getLoadStats() const;
+    
+    /** Human readable report of all the statistics, one line per stage */
+    String getReport() const;
+    
+    /** Clear all the statistics */
+    void reset();
+    
+private:
+    
+    static StageStats getStats(const StageHistogram &h);
+    
+    /** Time spent in each stage during the current block [ticks]. Audio thread only */
+    int64 blockTicks[NUM_STAGES];
+    
+    /** Histograms of each stage */
+    StageHistogram stageHistograms[NUM_STAGES];
+    
+    /** Histogram of the whole block */
+    StageHistogram blockHistogram;
+    
+    /** Histogram of the sum of the stages */
+    StageHistogram instrumentedHistogram;
+    
+    /** Histogram of the block load. Durations are used as load values, 1 s meaning the whole block */
+    StageHistogram loadHistogram;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (StageProfiler)
+};
+
+//==============================================================================
+
+/** Add the lifetime of the object to a stage of a StageProfiler. Does nothing if the profiler is null. */
+class ScopedStageTimer {
+    
+public:
+    
+    ScopedStageTimer(StageProfiler *p, ProcessingStage s) : profiler(p), stage(s) {
+        if (profiler != nullptr)
+            startTick = Time::getHighResolutionTicks();
+    }
+    
+    ~ScopedStageTimer() {
+        if (profiler != nullptr)
+            profiler->addTime(stage, Time::getHighResolutionTicks() - startTick);
+    }
+    
+private:
+    
+    StageProfiler *profiler;
+    ProcessingStage stage;
+    int64 startTick = 0;
+    
+    JUCE_DECLARE_NON_COPYABLE (ScopedStageTimer)
+};
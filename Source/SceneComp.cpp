@@ -8,27 +8,6 @@
 
 #include "SceneComp.h"
 
-void TileComp::paint(Graphics &g) {
-    
-    g.setColour(tileColour);
-    g.fillPath(path);
-    
-    g.setColour(Colours::black);
-    PathStrokeType strokeType(0.5f);
-    g.strokePath(path, strokeType);
-}
-
-
-void TileComp::setColour(const Colour &col) {
-    tileColour = col;
-}
-
-void TileComp::setPath(const Path& p) {
-    path = p;
-}
-//==============================================================================
-//==============================================================================
-
 GridComp::GridComp() {
     // Compute led tresholds
     const float ledStep = 3; //dB
@@ -45,84 +24,172 @@ void GridComp::setCallback(const Callback *c) {
     callback = c;
 }
 
-void GridComp::setParams(const std::atomic<float> *config,
-                         const std::atomic<float> *frontFacing) {
+void GridComp::setParams(const std::atomic<float> *frontFacing) {
     frontFacingParam = frontFacing;
-    configParam = config;
+}
+
+void GridComp::paint(Graphics &g) {
+    GenericScopedLock<SpinLock> l(lock);
+    if (heatmap.isValid()) {
+        g.drawImageAt(heatmap, 0, 0);
+    }
 }
 
 void GridComp::resized() {
     
-    if (frontFacingParam != nullptr && configParam != nullptr){
+    if (frontFacingParam != nullptr && callback != nullptr){
         stopTimer();
         GenericScopedLock<SpinLock> l(lock);
         area = getLocalBounds();
         
-        makeLayout();
-        
-        AffineTransform transf;
+        resetGrid();
         
-        if ((bool)(*frontFacingParam)){
-            if (isLinearArray(static_cast<MicConfig>((int)*configParam))){
-                transf = AffineTransform::rotation(pi, area.getWidth()/2, area.getHeight()/2);
+        startTimerHz(gridUpdateFrequency);
+    }
+    
+}
+
+void GridComp::resetGrid() {
+    
+    makeLayout();
+    
+    AffineTransform transf;
+    
+    if ((bool)(*frontFacingParam)){
+        if (isLinearArray(callback->getArrayLayout())){
+            transf = AffineTransform::rotation(pi, area.getWidth()/2, area.getHeight()/2);
+        }else{
+            transf = AffineTransform::verticalFlip(area.getHeight()).rotation(pi, area.getWidth()/2, area.getHeight()/2);
+        }
+    }
+    
+    rasterizeTiles(transf);
+    repaint();
+    
+    tileColours.resize(numTileRows * numDoaHor);
+    for (int rowIdx = 0; rowIdx < numTileRows; rowIdx++) {
+        for (int colIdx = 0; colIdx < numDoaHor; colIdx++) {
+            Colour baseCol;
+            if (isLinearArray(callback->getArrayLayout())){
+                baseCol = SingleChannelLedBar::dbToColour(-100,th[rowIdx]);
             }else{
-                transf = AffineTransform::verticalFlip(area.getHeight()).rotation(pi, area.getWidth()/2, area.getHeight()/2);
+                baseCol = MultiChannelLedBar::dbToColor(0);
             }
+            tileColours[rowIdx * numDoaHor + colIdx] = baseCol.getPixelARGB();
         }
-        
-        for (int rowIdx = 0; rowIdx < tiles.size(); rowIdx++) {
-            for (int colIdx = 0; colIdx < tiles[rowIdx].size(); colIdx++) {
-                {
-                    Path path;
-                    path.startNewSubPath(vertices[rowIdx][colIdx]);
-                    path.lineTo(vertices[rowIdx + 1][colIdx]);
-                    path.lineTo(vertices[rowIdx + 1][colIdx + 1]);
-                    path.lineTo(vertices[rowIdx][colIdx + 1]);
-                    path.closeSubPath();
-                    
-                    path.applyTransform(transf);
-                    
-                    tiles[rowIdx][colIdx]->setPath(path);
-                }
-                
-                Colour baseCol;
-                if (isLinearArray(static_cast<MicConfig>((int)*configParam))){
-                    baseCol = SingleChannelLedBar::dbToColour(-100,th[rowIdx]);
-                }else{
-                    baseCol = MultiChannelLedBar::dbToColor(0);
+    }
+    renderHeatmap();
+    
+    energyPreGain = Mtx(numDoaVer, numDoaHor);
+    energy = Mtx(numDoaVer, numDoaHor);
+    energy.setConstant(-100);
+    energyPreGain.setConstant(-100);
+
+}
+
+void GridComp::rasterizeTiles(const AffineTransform &transf) {
+    
+    const int width = area.getWidth();
+    const int height = area.getHeight();
+    pixelTiles.assign(jmax(0, width * height), outsideTiles);
+    tileBounds.assign(numTileRows * numDoaHor, {});
+    heatmap = width > 0 && height > 0 ? Image(Image::ARGB, width, height, true) : Image();
+    
+    /** Fill each tile with its index, sampling the pixel centres */
+    for (int rowIdx = 0; rowIdx < numTileRows; rowIdx++) {
+        for (int colIdx = 0; colIdx < numDoaHor; colIdx++) {
+            Path path;
+            path.startNewSubPath(vertices[rowIdx][colIdx]);
+            path.lineTo(vertices[rowIdx + 1][colIdx]);
+            path.lineTo(vertices[rowIdx + 1][colIdx + 1]);
+            path.lineTo(vertices[rowIdx][colIdx + 1]);
+            path.closeSubPath();
+            
+            path.applyTransform(transf);
+            
+            const auto bounds = path.getBounds().getSmallestIntegerContainer().getIntersection({width, height});
+            /** Borders are drawn on the pixels before the next tile */
+            tileBounds[rowIdx * numDoaHor + colIdx] = bounds.expanded(1).getIntersection({width, height});
+            for (auto y = bounds.getY(); y < bounds.getBottom(); y++) {
+                for (auto x = bounds.getX(); x < bounds.getRight(); x++) {
+                    if (path.contains(x + 0.5f, y + 0.5f)) {
+                        pixelTiles[y * width + x] = rowIdx * numDoaHor + colIdx;
+                    }
                 }
-                tiles[rowIdx][colIdx]->setColour(baseCol);
-                
-                tiles[rowIdx][colIdx]->setBounds(area);
-                
             }
         }
-        
-        if (isLinearArray(static_cast<MicConfig>((int)*configParam))){
-            energyPreGain = Mtx(1, NUM_DOAX);
-            energy = Mtx(1, NUM_DOAX);
-        }else{
-            energyPreGain = Mtx(NUM_DOAY, NUM_DOAX);
-            energy = Mtx(NUM_DOAY, NUM_DOAX);
+    }
+    
+    /** Pixels next to a different tile draw the border */
+    const std::vector<int> fill(pixelTiles);
+    for (auto y = 0; y < height; y++) {
+        for (auto x = 0; x < width; x++) {
+            const int tile = fill[y * width + x];
+            if (tile == outsideTiles)
+                continue;
+            const bool rightDiffers = x + 1 < width && fill[y * width + x + 1] != tile;
+            const bool belowDiffers = y + 1 < height && fill[(y + 1) * width + x] != tile;
+            if (rightDiffers || belowDiffers) {
+                pixelTiles[y * width + x] = tileBorder;
+            }
+        }
+    }
+}
+
+void GridComp::renderTile(int tile) {
+    
+    const auto &bounds = tileBounds[tile];
+    if (!heatmap.isValid() || bounds.isEmpty())
+        return;
+    
+    const PixelARGB colour = tileColours[tile];
+    Image::BitmapData data(heatmap, bounds.getX(), bounds.getY(), bounds.getWidth(), bounds.getHeight(),
+                           Image::BitmapData::writeOnly);
+    for (auto y = 0; y < bounds.getHeight(); y++) {
+        const int *tiles = pixelTiles.data() + (bounds.getY() + y) * heatmap.getWidth() + bounds.getX();
+        for (auto x = 0; x < bounds.getWidth(); x++) {
+            if (tiles[x] == tile) {
+                *reinterpret_cast<PixelARGB *>(data.getPixelPointer(x, y)) = colour;
+            }
         }
-        energy.setConstant(-100);
-        energyPreGain.setConstant(-100);
-        
-        startTimerHz(gridUpdateFrequency);
     }
+}
+
+void GridComp::renderHeatmap() {
     
+    if (!heatmap.isValid())
+        return;
+    
+    const PixelARGB border = Colours::black.getPixelARGB();
+    const PixelARGB transparent(0, 0, 0, 0);
+    
+    Image::BitmapData data(heatmap, Image::BitmapData::writeOnly);
+    for (auto y = 0; y < data.height; y++) {
+        const int *tiles = pixelTiles.data() + y * data.width;
+        for (auto x = 0; x < data.width; x++) {
+            const int tile = tiles[x];
+            *reinterpret_cast<PixelARGB *>(data.getPixelPointer(x, y)) =
+                    tile >= 0 ? tileColours[tile] : (tile == tileBorder ? border : transparent);
+        }
+    }
 }
 
 void GridComp::timerCallback() {
     
     GenericScopedLock<SpinLock> l(lock);
     
-    Mtx newEnergy;
-    callback->getDoaEnergy(newEnergy);
+    callback->getDoaMap(newEnergy, newPeaks);
     
-    if (newEnergy.size() != energyPreGain.size())
+    if (newEnergy.size() == 0)
         return;
     
+    /** The grid resolution is chosen by the beamformer, follow it */
+    if (newEnergy.rows() != numDoaVer || newEnergy.cols() != numDoaHor) {
+        numDoaVer = (int) newEnergy.rows();
+        numDoaHor = (int) newEnergy.cols();
+        resetGrid();
+    }
+    
     energyPreGain = ((1 - inertia) * (newEnergy)) + (inertia * energyPreGain);
     
     // Very basic automatic gain
@@ -140,38 +207,44 @@ void GridComp::timerCallback() {
     
     energy = energyPreGain.array() + gain;
     
-    for (int rowIdx = 0; rowIdx < tiles.size(); rowIdx++) {
-        for (int colIdx = 0; colIdx < tiles[rowIdx].size(); colIdx++) {
-            if (configParam != nullptr){
-                if (isLinearArray(static_cast<MicConfig>((int)*configParam))){
-                    tiles[rowIdx][colIdx]->setColour(SingleChannelLedBar::dbToColour(energy(0,colIdx),th[rowIdx]));
+    for (int rowIdx = 0; rowIdx < numTileRows; rowIdx++) {
+        for (int colIdx = 0; colIdx < numDoaHor; colIdx++) {
+            if (callback != nullptr){
+                Colour col;
+                if (isLinearArray(callback->getArrayLayout())){
+                    col = SingleChannelLedBar::dbToColour(energy(0,colIdx),th[rowIdx]);
                 }else{
-                    tiles[rowIdx][colIdx]->setColour(MultiChannelLedBar::dbToColor(energy(rowIdx,colIdx)));
+                    col = MultiChannelLedBar::dbToColor(energy(rowIdx,colIdx));
+                }
+                /** Only the tiles that changed colour are drawn */
+                const int tile = rowIdx * numDoaHor + colIdx;
+                const PixelARGB pixel = col.getPixelARGB();
+                if (pixel.getNativeARGB() != tileColours[tile].getNativeARGB()) {
+                    tileColours[tile] = pixel;
+                    renderTile(tile);
+                    repaint(tileBounds[tile]);
                 }
             }
             
         }
     }
     
-    repaint();
-    
 }
 
 void GridComp::makeLayout() {
     
     vertices.resize(0);
-    tiles.resize(0);
     
-    if (isLinearArray(static_cast<MicConfig>((int)*configParam))){
-        vertices.resize(ULA_TILE_ROW_COUNT+1, std::vector<juce::Point<float>>(NUM_DOAX+1));
+    if (isLinearArray(callback->getArrayLayout())){
+        vertices.resize(ULA_TILE_ROW_COUNT+1, std::vector<juce::Point<float>>(numDoaHor+1));
         
-        float angle_diff = MathConstants<float>::pi / NUM_DOAX;
+        float angle_diff = MathConstants<float>::pi / numDoaHor;
         
         for (int rowIdx = 0; rowIdx <= ULA_TILE_ROW_COUNT; rowIdx++) {
             
             const float radius = jmin(area.getHeight(),area.getWidth()/2) * (1 - (exp((float) rowIdx / ULA_TILE_ROW_COUNT) - 1) / (exp(1) - 1));
             
-            for (int colIdx = 0; colIdx <= NUM_DOAX; colIdx++) {
+            for (int colIdx = 0; colIdx <= numDoaHor; colIdx++) {
                 const float angle = colIdx * angle_diff;
                 
                 vertices[rowIdx][colIdx].setX(area.getWidth() / 2 - radius * cos(angle));
@@ -181,13 +254,13 @@ void GridComp::makeLayout() {
         }
         
     }else{
-        vertices.resize(NUM_DOAY+1, std::vector<juce::Point<float>>(NUM_DOAX+1));
+        vertices.resize(numDoaVer+1, std::vector<juce::Point<float>>(numDoaHor+1));
         
-        const float deltaY = float(area.getHeight()) / NUM_DOAY;
-        const float deltaX = float(area.getWidth()) / NUM_DOAX;
+        const float deltaY = float(area.getHeight()) / numDoaVer;
+        const float deltaX = float(area.getWidth()) / numDoaHor;
         
-        for (int rowIdx = 0; rowIdx <= NUM_DOAY; rowIdx++) {
-            for (int colIdx = 0; colIdx <= NUM_DOAX; colIdx++) {
+        for (int rowIdx = 0; rowIdx <= numDoaVer; rowIdx++) {
+            for (int colIdx = 0; colIdx <= numDoaHor; colIdx++) {
                 vertices[rowIdx][colIdx].setY(rowIdx*deltaY);
                 vertices[rowIdx][colIdx].setX(colIdx*deltaX);
             }
@@ -195,23 +268,14 @@ void GridComp::makeLayout() {
         
     }
     
-    tiles.resize(vertices.size()-1);
-    for (auto &tilesRow : tiles){
-        tilesRow.resize(NUM_DOAX);
-        for (auto &tile :tilesRow){
-            tile = std::make_unique<TileComp>();
-            addAndMakeVisible(*tile);
-        }
-    }
-    
-    
+    numTileRows = (int) vertices.size() - 1;
     
 }
 
 //==============================================================================
 //==============================================================================
 
-void BeamComp::setParams(const std::atomic<float> *config,
+void BeamComp::setParams(const GridComp::Callback *layout,
                          const std::atomic<float> *frontFacing,
                          const std::atomic<float> *mute,
                          const std::atomic<float> *width,
@@ -222,7 +286,7 @@ void BeamComp::setParams(const std::atomic<float> *config,
     steerXParam = steerX;
     steerYParam = steerY;
     frontFacingParam = frontFacing;
-    configParam = config;
+    layoutCallback = layout;
 }
 
 void BeamComp::resized(){
@@ -234,7 +298,7 @@ void BeamComp::paint(Graphics &g) {
     path.clear();
     
     
-    if (isLinearArray(static_cast<MicConfig>((int)*configParam))){
+    if (isLinearArray(layoutCallback->getArrayLayout())){
         const float positionX = *steerXParam;
         
         const float width = (0.1 + 2.9 * (*widthParam)) * area.getWidth() / 10;
@@ -287,10 +351,10 @@ SceneComp::SceneComp() {
 void SceneComp::setCallback(Callback *c) {
     callback = c;
     grid.setCallback(c);
-    grid.setParams(c->getConfigParam(),c->getFrontFacingParam());
+    grid.setParams(c->getFrontFacingParam());
     
     for (auto idx = 0; idx < NUM_BEAMS; idx++) {
-        beams[idx].setParams(c->getConfigParam(), c->getFrontFacingParam(), c->getBeamMute(idx), c->getBeamWidth(idx), c->getBeamSteerX(idx), c->getBeamSteerY(idx));
+        beams[idx].setParams(c, c->getFrontFacingParam(), c->getBeamMute(idx), c->getBeamWidth(idx), c->getBeamSteerX(idx), c->getBeamSteerY(idx));
     }
     
     resized();
@@ -304,7 +368,7 @@ void SceneComp::resized() {
     area = getLocalBounds();
     
     if (callback != nullptr)
-        if (!isLinearArray(static_cast<MicConfig>((int)*callback->getConfigParam())))
+        if (!isLinearArray(callback->getArrayLayout()))
             area.removeFromTop(20);
     
     if (grid.getBounds() == area){
@@ -13,53 +13,36 @@
 #include "MeterComp.h"
 #include "Beamformer.h"
 
-class TileComp : public Component {
-public:
-    
-    TileComp() {};
-    
-    ~TileComp() {};
-    
-    void paint(Graphics &) override;
-    
-    void resized() override {};
-    
-    void setColour(const Colour &col);
-    
-    void setPath(const Path &);
-    
-private:
-    
-    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TileComp)
-    
-    Path path;
-    Colour tileColour;
-    
-    const std::atomic<float> *frontFacing = nullptr;
-    AffineTransform frontFacingTransf;
-};
-
-//==============================================================================
-
+/** DOA energy map, drawn as a single cached image
+ 
+ The tiles are rasterized once per layout into a lookup of the tile index of each pixel.
+ Each update only computes the colour of each tile and, for the tiles whose colour changed, copies it to their
+ pixels through the lookup and repaints their bounds only.
+ */
 class GridComp : public Component, public Timer {
 public:
     GridComp();
     
     ~GridComp() {};
     
+    void paint(Graphics &) override;
+    
     void resized() override;
     
     class Callback {
     public:
         virtual ~Callback() = default;
         
-        virtual void getDoaEnergy(Mtx &energy) const = 0;
+        /** Copy the DOA energy and its peaks, from the same DOA update. Called once per tick. */
+        virtual void getDoaMap(Mtx &energy, std::vector<DoaPeak> &peaks) const = 0;
+        
+        /** Current eSticks layout */
+        virtual ArrayLayout getArrayLayout() const = 0;
     };
     
     void setCallback(const Callback *p);
     
-    void setParams(const std::atomic<float> *config,
-                   const std::atomic<float> *frontFacing);
+    void setParams(const std::atomic<float> *frontFacing);
     
 private:
     
@@ -67,15 +50,33 @@ private:
     
     Rectangle<int> area;
     
-    std::vector<std::vector<std::unique_ptr<TileComp>>> tiles;
     std::vector<std::vector<juce::Point<float>>> vertices;
     
+    /** Number of rows of tiles. The ULA fan has its own number of rows. */
+    int numTileRows = 0;
+    
+    /** Tile index of each pixel, row by row. Negative outside the tiles and on their borders */
+    std::vector<int> pixelTiles;
+    static constexpr int outsideTiles = -1;
+    static constexpr int tileBorder = -2;
+    
+    /** Colour of each tile */
+    std::vector<PixelARGB> tileColours;
+    
+    /** Bounds of each tile, including its border */
+    std::vector<Rectangle<int>> tileBounds;
+    
+    /** The rendered map */
+    Image heatmap;
+    
     const Callback *callback = nullptr;
     const std::atomic<float> *frontFacingParam = nullptr;
-    const std::atomic<float> *configParam = nullptr;
     
     std::vector<float> th;
     
+    /** Last map received, kept across ticks to reuse its memory */
+    Mtx newEnergy;
+    std::vector<DoaPeak> newPeaks;
     Mtx energy, energyPreGain;
     float inertia = 0.85;
     float gain = 0;
@@ -83,8 +84,23 @@ private:
     
     const float gridUpdateFrequency = 10;
     
+    /** Number of directions of arrival, taken from the last energy map received */
+    int numDoaHor = 0, numDoaVer = 0;
+    
     void makeLayout();
     
+    /** Re-create the pixel lookup and energy buffers for the current area and grid size */
+    void resetGrid();
+    
+    /** Rasterize the tiles into the pixel lookup */
+    void rasterizeTiles(const AffineTransform &transf);
+    
+    /** Copy the colours of the tiles to the pixels of the image */
+    void renderHeatmap();
+    
+    /** Copy the colour of a tile to its pixels */
+    void renderTile(int tile);
+    
     void timerCallback() override;
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GridComp)
@@ -103,7 +119,7 @@ public:
     void resized() override;
     
     void setParams(
-                   const std::atomic<float> *config,
+                   const GridComp::Callback *layout,
                    const std::atomic<float> *frontFacing,
                    const std::atomic<float> *mute,
                    const std::atomic<float> *width,
@@ -124,7 +140,7 @@ private:
     const std::atomic<float> *widthParam = nullptr;
     const std::atomic<float> *steerXParam = nullptr;
     const std::atomic<float> *steerYParam = nullptr;
-    const std::atomic<float> *configParam = nullptr;
+    const GridComp::Callback *layoutCallback = nullptr;
     
     Rectangle<int> area;
     
@@ -147,8 +163,6 @@ public:
     public:
         virtual ~Callback() = default;
         
-        virtual const std::atomic<float> *getConfigParam() const = 0;
-        
         virtual const std::atomic<float> *getFrontFacingParam() const = 0;
         
         virtual const std::atomic<float> *getBeamMute(int idx) const = 0;
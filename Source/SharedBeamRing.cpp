@@ -0,0 +1,126 @@
+/*
+ Beams published in shared memory
+
+ Authors:
+ Luca Bondi (luca.bondi@polimi.it)
+*/
+
+#include "SharedBeamRing.h"
+
+static_assert(sizeof(SharedBeamRing::Header) == 64, "The shared memory header layout is part of the interface");
+
+/** Paths of the rings open in this process, so that two instances restored with the same name do not share a file */
+static CriticalSection openFilesLock;
+static StringArray openFiles;
+
+SharedBeamRing::SharedBeamRing(const File &file_, int numBeams, double sampleRate, double capacitySeconds) {
+
+    file = file_;
+
+    {
+        const ScopedLock lock(openFilesLock);
+        if (openFiles.contains(file.getFullPathName())) {
+            Logger::writeToLog(file.getFullPathName() + ": already published by another instance");
+            return;
+        }
+        openFiles.add(file.getFullPathName());
+        ownsFile = true;
+    }
+
+    const auto capacity = (uint32) nextPowerOfTwo(roundToInt(sampleRate * capacitySeconds));
+    const auto headerSize = (uint32) sizeof(Header);
+    const size_t fileSize = headerSize + sizeof(float) * (size_t) numBeams * capacity;
+
+    /** Zero-filled once, so that the audio thread never touches a page for the first time */
+    file.deleteFile();
+    MemoryBlock zeros(fileSize, true);
+    if (!file.replaceWithData(zeros.getData(), zeros.getSize())) {
+        return;
+    }
+
+    mapping = std::make_unique<MemoryMappedFile>(file, MemoryMappedFile::readWrite, false);
+    if (mapping->getData() == nullptr || mapping->getSize() < fileSize) {
+        mapping = nullptr;
+        return;
+    }
+
+    header = new(mapping->getData()) Header();
+    memcpy(header->magic, "eBeamRng", 8);
+    header->version = 2;
+    header->headerSize = headerSize;
+    header->numBeams = (uint32) numBeams;
+    header->capacity = capacity;
+    header->sampleRate = sampleRate;
+    header->writeClock = 0;
+    header->writeEndClock = 0;
+    header->writeTimeNs = 0;
+    header->state = 1;
+    jassert(header->writeClock.is_lock_free());
+
+    data = reinterpret_cast<float *>(static_cast<char *>(mapping->getData()) + headerSize);
+}
+
+SharedBeamRing::~SharedBeamRing() {
+    if (header != nullptr) {
+        header->state = 0;
+    }
+    mapping = nullptr;
+    if (!ownsFile)
+        return;
+    /** Consumers still mapping it keep their pages until they reopen */
+    file.deleteFile();
+    const ScopedLock lock(openFilesLock);
+    openFiles.removeString(file.getFullPathName());
+}
+
+bool SharedBeamRing::isValid() const {
+    return header != nullptr;
+}
+
+const File &SharedBeamRing::getFile() const {
+    return file;
+}
+
+void SharedBeamRing::write(const AudioBuffer<float> &beams, int numSamples) {
+    if (header == nullptr)
+        return;
+
+    const uint32 capacity = header->capacity;
+    jassert((uint32) numSamples <= capacity);
+    numSamples = jmin(numSamples, (int) capacity);
+
+    const uint64 clock = header->writeClock.load(std::memory_order_relaxed);
+    
+    /** Announce the samples about to be overwritten before touching them */
+    header->writeEndClock.store(clock + (uint64) numSamples, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    
+    const int start = (int) (clock & (capacity - 1));
+    const int size1 = jmin(numSamples, (int) capacity - start);
+    const int size2 = numSamples - size1;
+    const int numChannels = jmin(beams.getNumChannels(), (int) header->numBeams);
+    for (auto beamIdx = 0; beamIdx < (int) header->numBeams; beamIdx++) {
+        float *ring = data + (size_t) beamIdx * capacity;
+        if (beamIdx < numChannels) {
+            FloatVectorOperations::copy(ring + start, beams.getReadPointer(beamIdx), size1);
+            FloatVectorOperations::copy(ring, beams.getReadPointer(beamIdx) + size1, size2);
+        } else {
+            FloatVectorOperations::clear(ring + start, size1);
+            FloatVectorOperations::clear(ring, size2);
+        }
+    }
+
+    header->writeTimeNs.store((int64) (Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks()) * 1e9),
+                              std::memory_order_relaxed);
+    header->writeClock.store(clock + (uint64) numSamples, std::memory_order_release);
+}
+
+File SharedBeamRing::getFileForName(const String &name) {
+    const String fileName = "eBeamer-" + File::createLegalFileName(name) + ".beams";
+#if JUCE_LINUX
+    const File shm("/dev/shm");
+    if (shm.isDirectory())
+        return shm.getChildFile(fileName);
+#endif
+    return File::getSpecialLocation(File::tempDirectory).getChildFile(fileName);
+}
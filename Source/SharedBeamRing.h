@@ -0,0 +1,95 @@
+/*
+ Beams published in shared memory
+
+ Authors:
+ Luca Bondi (luca.bondi@polimi.it)
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+/** Lock-free ring of beam samples in a memory mapped file, for local consumers
+
+ The file starts with a Header of headerSize bytes, followed by numBeams planar rings of capacity 32 bit floats.
+ Sample n of the stream, counted since the ring was created, of beam b is at data[b * capacity + n % capacity].
+ A single writer, the audio thread, writes each block of n samples as:
+ 1. stores writeEndClock = writeClock + n (relaxed), then std::atomic_thread_fence(release)
+ 2. copies the samples, overwriting the ones older than writeEndClock - capacity
+ 3. stores writeClock = writeEndClock (release)
+
+ A consumer maps the file read-only and, for each read:
+ 1. loads writeClock (acquire), c1
+ 2. copies the samples it needs in [max(next, c1 - capacity), c1)
+ 3. std::atomic_thread_fence(acquire), then loads writeEndClock (relaxed), e
+ 4. discards the copied samples older than e - capacity: they may have been overwritten while being copied
+ The fence of step 3 keeps the copies of step 2 from being reordered after the load of writeEndClock, and it pairs
+ with the fence of the writer: a copy that read any sample of a later block is followed by an e that covers it.
+ The consumer never blocks the writer, and it falls behind by at most capacity samples before losing some.
+ When the writer goes away, state becomes closed and the file may be replaced by a new ring: consumers reopen it.
+ */
+class SharedBeamRing {
+
+public:
+
+    /** Layout of the start of the file. Native byte order, 64 bytes. */
+    struct Header {
+        /** "eBeamRng" */
+        char magic[8];
+        /** Layout version, currently 2 */
+        uint32 version;
+        /** Offset of the first sample from the start of the file [bytes] */
+        uint32 headerSize;
+        /** Number of beams */
+        uint32 numBeams;
+        /** Samples per beam in the ring, a power of two */
+        uint32 capacity;
+        /** Sample rate [Hz] */
+        double sampleRate;
+        /** Number of samples written per beam. Also the sample clock of the next sample */
+        std::atomic<uint64> writeClock;
+        /** Time of the last write, from Time::getHighResolutionTicks converted to [ns] */
+        std::atomic<int64> writeTimeNs;
+        /** 1 while the writer is alive, 0 once closed */
+        std::atomic<uint32> state;
+        uint32 reserved;
+        /** Sample clock the block being written ends at. Equal to writeClock between writes */
+        std::atomic<uint64> writeEndClock;
+    };
+
+    /** Create the file and map it. Message thread only.
+
+     The ring is not valid if another ring of this process already uses the file.
+     @param capacitySeconds: minimum duration of the ring [s]
+     */
+    SharedBeamRing(const File &file, int numBeams, double sampleRate, double capacitySeconds);
+
+    /** Mark the ring closed and delete the file, if this ring created it */
+    ~SharedBeamRing();
+
+    /** True if the file has been created and mapped */
+    bool isValid() const;
+
+    /** Append the first numSamples of each beam. Audio thread, wait-free. */
+    void write(const AudioBuffer<float> &beams, int numSamples);
+
+    /** File backing the ring */
+    const File &getFile() const;
+
+    /** File of a ring with the given name, in memory-backed storage when available */
+    static File getFileForName(const String &name);
+
+private:
+
+    File file;
+
+    /** True once the file has been claimed in this process */
+    bool ownsFile = false;
+
+    std::unique_ptr<MemoryMappedFile> mapping;
+
+    Header *header = nullptr;
+    float *data = nullptr;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SharedBeamRing)
+};
@@ -0,0 +1,128 @@
+/*
+ Input analysis shared by the instances of the same array
+
+ Authors:
+ Luca Bondi (luca.bondi@polimi.it)
+*/
+
+#include "SharedInputAnalysis.h"
+
+//==============================================================================
+bool SharedInputAnalysis::prepare(const AudioBufferFFT &spectra, int maximumExpectedSamplesPerBlock) {
+    GenericScopedLock<CriticalSection> l(lock);
+    if (prepared) {
+        return slots[0].spectra.getNumChannels() == spectra.getNumChannels() &&
+               slots[0].spectra.getNumSamples() == spectra.getNumSamples() &&
+               slots[0].input.getNumSamples() == maximumExpectedSamplesPerBlock;
+    }
+    for (auto &slot : slots) {
+        slot.input.setSize(spectra.getNumChannels(), maximumExpectedSamplesPerBlock);
+        slot.spectra = spectra;
+    }
+    prepared = true;
+    return true;
+}
+
+bool SharedInputAnalysis::matches(const Slot &slot, const AudioBuffer<float> &inBuffer) const {
+    if (slot.numSamples != inBuffer.getNumSamples() || inBuffer.getNumChannels() < slot.input.getNumChannels())
+        return false;
+    /** Most mismatching slots differ on the first channel already */
+    for (auto chIdx = 0; chIdx < slot.input.getNumChannels(); chIdx++) {
+        if (memcmp(slot.input.getReadPointer(chIdx), inBuffer.getReadPointer(chIdx),
+                   sizeof(float) * (size_t) slot.numSamples) != 0)
+            return false;
+    }
+    return true;
+}
+
+int SharedInputAnalysis::acquire(const AudioBuffer<float> &inBuffer) {
+    if (!prepared)
+        return -1;
+    for (auto slotIdx = 0; slotIdx < numSlots; slotIdx++) {
+        auto &slot = slots[slotIdx];
+        /** Register as a reader before checking the version, publish does the opposite */
+        slot.numReaders++;
+        const auto version = slot.version.load();
+        if (version != 0 && (version & 1) == 0 && matches(slot, inBuffer))
+            return slotIdx;
+        slot.numReaders--;
+    }
+    return -1;
+}
+
+const AudioBufferFFT &SharedInputAnalysis::getSpectra(int slotIdx) const {
+    return slots[slotIdx].spectra;
+}
+
+void SharedInputAnalysis::release(int slotIdx) {
+    slots[slotIdx].numReaders--;
+}
+
+void SharedInputAnalysis::publish(const AudioBuffer<float> &inBuffer, const AudioBufferFFT &spectra) {
+    if (!prepared || inBuffer.getNumSamples() > slots[0].input.getNumSamples() ||
+        inBuffer.getNumChannels() < slots[0].input.getNumChannels())
+        return;
+    const int firstSlot = nextSlot.load();
+    for (auto offset = 0; offset < numSlots; offset++) {
+        const int slotIdx = (firstSlot + offset) % numSlots;
+        auto &slot = slots[slotIdx];
+        auto version = slot.version.load();
+        if ((version & 1) != 0 || !slot.version.compare_exchange_strong(version, version + 1))
+            continue;
+        if (slot.numReaders.load() != 0) {
+            slot.version = version;
+            continue;
+        }
+        for (auto chIdx = 0; chIdx < slot.input.getNumChannels(); chIdx++)
+            slot.input.copyFrom(chIdx, 0, inBuffer, chIdx, 0, inBuffer.getNumSamples());
+        slot.numSamples = inBuffer.getNumSamples();
+        slot.spectra = spectra;
+        slot.version = version + 2;
+        nextSlot = (slotIdx + 1) % numSlots;
+        return;
+    }
+}
+
+bool SharedInputAnalysis::isLeader(const Beamformer *member) const {
+    return leader.load() == member;
+}
+
+void SharedInputAnalysis::getDoaMap(Mtx &energy, std::vector<DoaPeak> &peaks) const {
+    GenericScopedLock<CriticalSection> l(lock);
+    if (auto *bf = leader.load())
+        bf->getDoaMap(energy, peaks);
+}
+
+//==============================================================================
+std::shared_ptr<SharedInputAnalysis> SharedInputRegistry::join(const String &key, Beamformer *member) {
+    GenericScopedLock<CriticalSection> l(lock);
+    auto group = groups[key].lock();
+    if (group == nullptr) {
+        group = std::make_shared<SharedInputAnalysis>();
+        groups[key] = group;
+    }
+    GenericScopedLock<CriticalSection> gl(group->lock);
+    group->members.addIfNotAlreadyThere(member);
+    group->leader = group->members.getFirst();
+    return group;
+}
+
+void SharedInputRegistry::leave(const std::shared_ptr<SharedInputAnalysis> &group, Beamformer *member) {
+    GenericScopedLock<CriticalSection> l(lock);
+    {
+        GenericScopedLock<CriticalSection> gl(group->lock);
+        group->members.removeAllInstancesOf(member);
+        group->leader = group->members.isEmpty() ? nullptr : group->members.getFirst();
+        /** The new leader feeds the DOA from now on */
+        if (auto *bf = group->leader.load())
+            bf->startDoa();
+    }
+    /** Forget the groups left without members */
+    for (auto it = groups.begin(); it != groups.end();) {
+        auto g = it->second.lock();
+        if (g == nullptr || (g == group && group->members.isEmpty()))
+            it = groups.erase(it);
+        else
+            ++it;
+    }
+}
@@ -0,0 +1,119 @@
+/*
+ Input analysis shared by the instances of the same array
+
+ Authors:
+ Luca Bondi (luca.bondi@polimi.it)
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "Beamformer.h"
+
+/** Input spectra and DOA of one microphone array, shared by all the instances processing it
+
+ Several instances fed by the same array compute the very same input spectra and directions of arrival.
+ The first instance processing a block transforms its input and publishes the spectra in one of a few slots.
+ The other instances look for a slot computed from the same input samples and convolve their beams
+ directly from it, without copying. A slot is identified by the conditioned input samples themselves,
+ hence instances processed in any order, or with different input gain or HPF, never consume wrong spectra:
+ they simply fall back to transforming their own input.
+ Only the leader, the first member to join, runs and feeds a DOA thread. The other members read the DOA from it,
+ and start their own only when they become the leader.
+
+ Audio thread methods are lock-free and allocation-free.
+ */
+class SharedInputAnalysis {
+
+public:
+
+    SharedInputAnalysis() = default;
+
+    /** Allocate the slots like the input spectra of a member. Message thread only.
+     
+     Once allocated, only checks that the spectra of the member match the slots.
+     @return: false if the spectra or the block size of the member differ from the ones of the group
+     */
+    bool prepare(const AudioBufferFFT &spectra, int maximumExpectedSamplesPerBlock);
+
+    /** Find the slot whose spectra were computed from inBuffer. Audio thread.
+
+     @return: slot index, to be released after use, or -1 if no slot matches
+     */
+    int acquire(const AudioBuffer<float> &inBuffer);
+
+    /** Spectra of an acquired slot */
+    const AudioBufferFFT &getSpectra(int slotIdx) const;
+
+    /** Release a slot returned by acquire */
+    void release(int slotIdx);
+
+    /** Publish the spectra computed from inBuffer. Audio thread. Skipped if all slots are being read. */
+    void publish(const AudioBuffer<float> &inBuffer, const AudioBufferFFT &spectra);
+
+    /** True if member feeds the DOA shared by the group */
+    bool isLeader(const Beamformer *member) const;
+
+    /** Copy the DOA map of the leader, see Beamformer::getDoaMap. Message thread only. */
+    void getDoaMap(Mtx &energy, std::vector<DoaPeak> &peaks) const;
+
+private:
+
+    friend class SharedInputRegistry;
+
+    /** Spectra computed from a block of conditioned input */
+    struct Slot {
+        /** Even when the slot is stable, odd while it is being written. 0 if never written. */
+        std::atomic<uint32> version{0};
+        /** Number of instances reading the slot */
+        std::atomic<int> numReaders{0};
+        /** Conditioned input the spectra were computed from */
+        AudioBuffer<float> input;
+        int numSamples = 0;
+        /** Input spectra, ready for convolution */
+        AudioBufferFFT spectra;
+    };
+
+    /** Number of slots. Members lagging behind by more blocks transform their own input */
+    static const int numSlots = 4;
+
+    Slot slots[numSlots];
+
+    /** Next slot to be written */
+    std::atomic<int> nextSlot{0};
+
+    /** Slots are allocated */
+    std::atomic<bool> prepared{false};
+
+    /** Members, the leader first. Changed with lock held, on the message thread */
+    Array<Beamformer *> members;
+    std::atomic<Beamformer *> leader{nullptr};
+    CriticalSection lock;
+
+    /** True if slot was computed from inBuffer */
+    bool matches(const Slot &slot, const AudioBuffer<float> &inBuffer) const;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SharedInputAnalysis);
+};
+
+/** Process-wide registry of the shared input analyses, one per array ID. Hold it with a SharedResourcePointer. */
+class SharedInputRegistry {
+
+public:
+
+    SharedInputRegistry() = default;
+
+    /** Add member to the group of key, creating it if needed. Message thread only. */
+    std::shared_ptr<SharedInputAnalysis> join(const String &key, Beamformer *member);
+
+    /** Remove member from its group. The next member, if any, becomes the leader and starts its DOA thread. Message thread only. */
+    void leave(const std::shared_ptr<SharedInputAnalysis> &group, Beamformer *member);
+
+private:
+
+    CriticalSection lock;
+
+    std::map<String, std::weak_ptr<SharedInputAnalysis>> groups;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SharedInputRegistry);
+};
@@ -56,3 +56,67 @@ freqToTime(AudioBuffer<float> &time, const int timeCh, const CpxVec &freq, const
     }
 
 }
+
+/** Peak and sum of squares of one channel, optionally scaling the samples in place by gain first */
+template<bool applyGain>
+static void measureChannelLevels(float *data, int numSamples, float gain, float &peak, float &energy) {
+    
+    peak = 0;
+    energy = 0;
+    int smpIdx = 0;
+    
+#if JUCE_USE_SIMD
+    typedef dsp::SIMDRegister<float> Reg;
+    /** Scalar head up to the first aligned sample, then full registers */
+    const int numHead = jmin(numSamples, (int) (Reg::getNextSIMDAlignedPtr(data) - data));
+    for (; smpIdx < numHead; smpIdx++) {
+        if (applyGain) {
+            data[smpIdx] *= gain;
+        }
+        peak = jmax(peak, std::abs(data[smpIdx]));
+        energy += data[smpIdx] * data[smpIdx];
+    }
+    const Reg gainReg = Reg::expand(gain);
+    Reg peakReg = Reg::expand(0);
+    Reg energyReg = Reg::expand(0);
+    for (; smpIdx + (int) Reg::size() <= numSamples; smpIdx += (int) Reg::size()) {
+        Reg x = Reg::fromRawArray(data + smpIdx);
+        if (applyGain) {
+            x *= gainReg;
+            x.copyToRawArray(data + smpIdx);
+        }
+        peakReg = Reg::max(peakReg, Reg::abs(x));
+        energyReg += x * x;
+    }
+    for (size_t lane = 0; lane < Reg::size(); lane++) {
+        peak = jmax(peak, peakReg.get(lane));
+    }
+    energy += energyReg.sum();
+#endif
+    
+    for (; smpIdx < numSamples; smpIdx++) {
+        if (applyGain) {
+            data[smpIdx] *= gain;
+        }
+        peak = jmax(peak, std::abs(data[smpIdx]));
+        energy += data[smpIdx] * data[smpIdx];
+    }
+}
+
+void measureLevels(const AudioBuffer<float> &signal, int numChannels, float *peaks, float *sumSquares) {
+    
+    for (auto chIdx = 0; chIdx < numChannels; chIdx++) {
+        /** Read only, the samples are not written when no gain is applied */
+        measureChannelLevels<false>(const_cast<float *>(signal.getReadPointer(chIdx)), signal.getNumSamples(), 1,
+                                    peaks[chIdx], sumSquares[chIdx]);
+    }
+}
+
+void applyGainAndMeasureLevels(AudioBuffer<float> &signal, int numChannels, float gain, float *peaks,
+                               float *sumSquares) {
+    
+    for (auto chIdx = 0; chIdx < numChannels; chIdx++) {
+        measureChannelLevels<true>(signal.getWritePointer(chIdx), signal.getNumSamples(), gain,
+                                   peaks[chIdx], sumSquares[chIdx]);
+    }
+}
@@ -39,3 +39,25 @@ void designTukeyWindow(Vec &win, size_t winLen, size_t rampLen);
  */
 void freqToTime(AudioBuffer<float> &time, const int timeCh, const CpxVec &freq, const juce::dsp::FFT *fft,
                 const Vec &window = Vec(), float alpha = 1);
+
+/** Peak of the absolute value and sum of squares of the first numChannels of a buffer
+ 
+ Both are computed in the same vectorized pass over the samples.
+ @param signal: source buffer
+ @param numChannels: number of channels to measure
+ @param peaks: destination peaks, numChannels values
+ @param sumSquares: destination sums of squares, numChannels values
+ */
+void measureLevels(const AudioBuffer<float> &signal, int numChannels, float *peaks, float *sumSquares);
+
+/** Scale the first numChannels of a buffer in place by a constant gain and measure the result
+
+ Same levels as measureLevels on the scaled signal, but gain and measurement share a single vectorized pass.
+ @param signal: buffer, scaled in place
+ @param numChannels: number of channels to scale and measure
+ @param gain: linear gain
+ @param peaks: destination peaks, numChannels values
+ @param sumSquares: destination sums of squares, numChannels values
+ */
+void applyGainAndMeasureLevels(AudioBuffer<float> &signal, int numChannels, float gain, float *peaks,
+                               float *sumSquares);
@@ -0,0 +1,138 @@
+/*
+ eBeamer standalone application
+ 
+ Authors:
+ Luca Bondi (luca.bondi@polimi.it)
+*/
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+#if JucePlugin_Build_Standalone && JUCE_USE_CUSTOM_PLUGIN_STANDALONE_APP
+
+#include <juce_audio_plugin_client/Standalone/juce_StandaloneFilterWindow.h>
+#include "Benchmark.h"
+#include "BatchRenderer.h"
+#include "HeadlessServer.h"
+#include "PluginProcessor.h"
+
+/** The standalone plugin window, plus command line modes that run without any GUI
+ 
+ --benchmark [options]   measure the Beamformer throughput, see BeamformerBenchmark
+ --render [options]      render recordings offline, one file per beam, see BatchRenderer
+ --headless file         run one beamformer per array from a configuration file until stopped, see HeadlessServer
+ 
+ and options for the window:
+ 
+ --record folder         capture the raw microphone signals to folder while beamforming, see InputRecorder
+ --shared-output name    publish the beams to local processes in shared memory, see SharedBeamRing
+ */
+class EbeamerStandaloneApp : public JUCEApplication {
+    
+public:
+    
+    EbeamerStandaloneApp() {
+        PluginHostType::jucePlugInClientCurrentWrapperType = AudioProcessor::wrapperType_Standalone;
+        
+        PropertiesFile::Options options;
+        options.applicationName = getApplicationName();
+        options.filenameSuffix = ".settings";
+        options.osxLibrarySubFolder = "Application Support";
+#if JUCE_LINUX
+        options.folderName = "~/.config";
+#else
+        options.folderName = "";
+#endif
+        appProperties.setStorageParameters(options);
+    }
+    
+    const String getApplicationName() override { return JucePlugin_Name; }
+    
+    const String getApplicationVersion() override { return JucePlugin_VersionString; }
+    
+    bool moreThanOneInstanceAllowed() override { return true; }
+    
+    void anotherInstanceStarted(const String &) override {}
+    
+    void initialise(const String &) override {
+        
+        const ArgumentList args(getApplicationName(), getCommandLineParameterArray());
+        
+        if (args.containsOption("--benchmark")) {
+            BeamformerBenchmark benchmark(args);
+            setApplicationReturnValue(benchmark.run());
+            quit();
+            return;
+        }
+        
+        if (args.containsOption("--render")) {
+            BatchRenderer renderer(args);
+            setApplicationReturnValue(renderer.run());
+            quit();
+            return;
+        }
+        
+        if (args.containsOption("--headless")) {
+            headlessServer = std::make_unique<HeadlessServer>(args);
+            if (!headlessServer->start()) {
+                setApplicationReturnValue(1);
+                quit();
+            }
+            return;
+        }
+        
+        mainWindow = std::make_unique<StandaloneFilterWindow>(
+                getApplicationName(),
+                LookAndFeel::getDefaultLookAndFeel().findColour(ResizableWindow::backgroundColourId),
+                appProperties.getUserSettings(), false);
+        mainWindow->setVisible(true);
+        
+        if (args.containsOption("--record")) {
+            auto *processor = dynamic_cast<EbeamerAudioProcessor *>(mainWindow->getAudioProcessor());
+            const File folder = args.getFileForOption("--record");
+            if (processor == nullptr || !processor->startRecording(folder)) {
+                AlertWindow::showMessageBoxAsync(AlertWindow::WarningIcon, getApplicationName(),
+                                                 "Cannot record to " + folder.getFullPathName());
+            }
+        }
+        
+        if (args.containsOption("--shared-output")) {
+            auto *processor = dynamic_cast<EbeamerAudioProcessor *>(mainWindow->getAudioProcessor());
+            const String name = args.getValueForOption("--shared-output");
+            if (processor == nullptr || !processor->startSharedOutput(name)) {
+                AlertWindow::showMessageBoxAsync(AlertWindow::WarningIcon, getApplicationName(),
+                                                 "Cannot publish beams to shared memory " + name);
+            }
+        }
+    }
+    
+    void shutdown() override {
+        headlessServer = nullptr;
+        mainWindow = nullptr;
+        appProperties.saveIfNeeded();
+    }
+    
+    void systemRequestedQuit() override {
+        if (mainWindow != nullptr)
+            mainWindow->pluginHolder->savePluginState();
+        
+        if (ModalComponentManager::getInstance()->cancelAllModalComponents()) {
+            Timer::callAfterDelay(100, []() {
+                if (auto app = JUCEApplicationBase::getInstance())
+                    app->systemRequestedQuit();
+            });
+        } else {
+            quit();
+        }
+    }
+    
+private:
+    
+    ApplicationProperties appProperties;
+    std::unique_ptr<StandaloneFilterWindow> mainWindow;
+    std::unique_ptr<HeadlessServer> headlessServer;
+    
+};
+
+JUCE_CREATE_APPLICATION_DEFINE(EbeamerStandaloneApp)
+
+#endif
@@ -0,0 +1,168 @@
+/*
+ Event trace recorder
+ 
+ Authors:
+ Luca Bondi (luca.bondi@polimi.it)
+*/
+
+#include "TraceRecorder.h"
+
+TraceRecorder::TraceRecorder() : Thread("Trace writer") {
+    slots = std::make_unique<Slot[]>(capacity);
+    outputDirectory = File::getSpecialLocation(File::tempDirectory).getChildFile("eBeamerTraces");
+    lastSnapshotMs = Time::getMillisecondCounter() - minSnapshotIntervalMs;
+    startThread(2);
+}
+
+TraceRecorder::~TraceRecorder() {
+    stopThread(3000);
+}
+
+void TraceRecorder::begin(const char *name, const char *category) {
+    record('B', name, category);
+}
+
+void TraceRecorder::end(const char *name, const char *category) {
+    record('E', name, category);
+}
+
+void TraceRecorder::instant(const char *name, const char *category) {
+    record('i', name, category);
+}
+
+void TraceRecorder::record(char phase, const char *name, const char *category) {
+    if (frozen.load(std::memory_order_relaxed)) {
+        return;
+    }
+    const uint64 idx = writeIdx.fetch_add(1, std::memory_order_relaxed);
+    Slot &slot = slots[idx & (capacity - 1)];
+    /** Invalidate the slot while it is being written, then publish it */
+    slot.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.tick = Time::getHighResolutionTicks();
+    slot.name = name;
+    slot.category = category;
+    slot.threadId = Thread::getCurrentThreadId();
+    slot.phase = phase;
+    slot.seq.store(idx + 1, std::memory_order_release);
+}
+
+void TraceRecorder::triggerSnapshot() {
+    /** No more snapshots will be written, do not freeze and copy the ring for nothing */
+    if (numSnapshots.load(std::memory_order_relaxed) >= maxSnapshots) {
+        return;
+    }
+    const uint32 now = Time::getMillisecondCounter();
+    if (now - lastSnapshotMs.load(std::memory_order_relaxed) < minSnapshotIntervalMs) {
+        return;
+    }
+    instant("deadline miss", "audio");
+    if (!frozen.exchange(true)) {
+        lastSnapshotMs = now;
+        notify();
+    }
+}
+
+void TraceRecorder::setOutputDirectory(const File &dir) {
+    const ScopedLock lock(fileLock);
+    outputDirectory = dir;
+}
+
+File TraceRecorder::getLastSnapshot() const {
+    const ScopedLock lock(fileLock);
+    return lastSnapshot;
+}
+
+void TraceRecorder::copyRing(std::vector<Event> &events) const {
+    const uint64 endIdx = writeIdx.load(std::memory_order_acquire);
+    const uint64 startIdx = endIdx > (uint64) capacity ? endIdx - capacity : 0;
+    events.clear();
+    events.reserve(endIdx - startIdx);
+    for (auto idx = startIdx; idx < endIdx; idx++) {
+        const Slot &slot = slots[idx & (capacity - 1)];
+        /** Skip slots still being written by a thread that started before the freeze */
+        if (slot.seq.load(std::memory_order_acquire) != idx + 1) {
+            continue;
+        }
+        Event e{slot.tick, slot.name, slot.category, slot.threadId, slot.phase};
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) == idx + 1) {
+            events.push_back(e);
+        }
+    }
+}
+
+void TraceRecorder::run() {
+    
+    std::vector<Event> events;
+    
+    while (!threadShouldExit()) {
+        
+        wait(-1);
+        
+        if (!frozen) {
+            continue;
+        }
+        
+        /** Give threads writing when the ring was frozen the time to complete their events */
+        Thread::sleep(1);
+        copyRing(events);
+        frozen = false;
+        
+        if (numSnapshots >= maxSnapshots) {
+            continue;
+        }
+        
+        const ScopedLock lock(fileLock);
+        outputDirectory.createDirectory();
+        const File file = outputDirectory.getNonexistentChildFile(
+                "trace-" + Time::getCurrentTime().formatted("%Y%m%d-%H%M%S"), ".json");
+        if (writeChromeTrace(events, file)) {
+            lastSnapshot = file;
+            numSnapshots++;
+        }
+    }
+}
+
+bool TraceRecorder::writeChromeTrace(const std::vector<Event> &events, const File &file) {
+    
+    FileOutputStream out(file);
+    if (out.failedToOpen()) {
+        return false;
+    }
+    
+    const int64 firstTick = events.empty() ? 0 : events.front().tick;
+    const int pid = 1;
+    
+    /** Threads are named after the category of their first event */
+    std::map<Thread::ThreadID, const char *> threadNames;
+    
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    for (const auto &e : events) {
+        if (threadNames.count(e.threadId) == 0) {
+            threadNames[e.threadId] = e.category;
+        }
+        if (!first) {
+            out << ",\n";
+        }
+        first = false;
+        const double ts = Time::highResolutionTicksToSeconds(e.tick - firstTick) * 1e6;
+        out << "{\"name\":\"" << e.name << "\",\"cat\":\"" << e.category << "\",\"ph\":\"" << String::charToString(e.phase)
+            << "\",\"ts\":" << String(ts, 3) << ",\"pid\":" << pid << ",\"tid\":" << String((int64) (pointer_sized_int) e.threadId);
+        if (e.phase == 'i') {
+            out << ",\"s\":\"p\"";
+        }
+        out << "}";
+    }
+    for (const auto &t : threadNames) {
+        out << (first ? "" : ",\n");
+        first = false;
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":"
+            << String((int64) (pointer_sized_int) t.first) << ",\"args\":{\"name\":\"" << t.second << "\"}}";
+    }
+    out << "\n]}\n";
+    out.flush();
+    
+    return out.getStatus().wasOk();
+}
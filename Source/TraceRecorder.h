@@ -0,0 +1,137 @@
+/*
+ Event trace recorder
+ 
+ Authors:
+ Luca Bondi (luca.bondi@polimi.it)
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+/** Continuous trace of begin/end events from any thread, dumped to file when a deadline is missed.
+ 
+ Events are stored in a fixed-size ring, overwriting the oldest ones. Recording is wait-free and allocation-free,
+ hence it can stay enabled on the audio thread. When triggerSnapshot is called the ring is frozen and a
+ background thread writes its content as a Chrome trace JSON file (chrome://tracing, ui.perfetto.dev),
+ then recording resumes. Events recorded while frozen are dropped.
+ 
+ Shared by all the plugin instances in the process through SharedResourcePointer.
+ */
+class TraceRecorder : private Thread {
+    
+public:
+    
+    TraceRecorder();
+    
+    ~TraceRecorder();
+    
+    /** Begin of a named interval on the calling thread. Name and category must be string literals. */
+    void begin(const char *name, const char *category);
+    
+    /** End of a named interval on the calling thread */
+    void end(const char *name, const char *category);
+    
+    /** Instantaneous event on the calling thread */
+    void instant(const char *name, const char *category);
+    
+    /** Freeze the ring and have it written to file. Safe to call from the audio thread.
+     
+     Ignored while a snapshot is being written, if the previous snapshot is too recent or once maxSnapshots are written.
+     */
+    void triggerSnapshot();
+    
+    /** Set the directory where snapshots are written. Message thread only. */
+    void setOutputDirectory(const File &dir);
+    
+    /** Last snapshot written, if any */
+    File getLastSnapshot() const;
+    
+private:
+    
+    /** A slot of the ring. seq is index + 1 once the event with that index is completely written */
+    struct Slot {
+        std::atomic<uint64> seq{0};
+        int64 tick = 0;
+        const char *name = nullptr;
+        const char *category = nullptr;
+        Thread::ThreadID threadId = nullptr;
+        char phase = 0;
+    };
+    
+    /** A copy of an event, owned by the writer thread */
+    struct Event {
+        int64 tick;
+        const char *name;
+        const char *category;
+        Thread::ThreadID threadId;
+        char phase;
+    };
+    
+    void record(char phase, const char *name, const char *category);
+    
+    /** Writer thread */
+    void run() override;
+    
+    /** Copy the valid events of the ring, oldest first */
+    void copyRing(std::vector<Event> &events) const;
+    
+    /** Write events as Chrome trace JSON */
+    static bool writeChromeTrace(const std::vector<Event> &events, const File &file);
+    
+    /** Number of events in the ring. Power of two */
+    static constexpr int capacity = 1 << 16;
+    
+    /** Minimum time between two snapshots [ms] */
+    static constexpr uint32 minSnapshotIntervalMs = 5000;
+    
+    /** Maximum number of snapshots written per session */
+    static constexpr int maxSnapshots = 20;
+    
+    std::unique_ptr<Slot[]> slots;
+    
+    /** Index of the next event to be written */
+    std::atomic<uint64> writeIdx{0};
+    
+    /** True while the writer thread is copying the ring */
+    std::atomic<bool> frozen{false};
+    
+    /** Time of the last snapshot [ms], see Time::getMillisecondCounter */
+    std::atomic<uint32> lastSnapshotMs{0};
+    
+    /** Number of snapshots written. Read by triggerSnapshot, hence atomic */
+    std::atomic<int> numSnapshots{0};
+    
+    /** Output directory and last file written */
+    File outputDirectory;
+    File lastSnapshot;
+    CriticalSection fileLock;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TraceRecorder)
+};
+
+//==============================================================================
+
+/** Trace the lifetime of the object as an interval. Does nothing if the recorder is null. */
+class ScopedTrace {
+    
+public:
+    
+    ScopedTrace(TraceRecorder *r, const char *n, const char *c) : recorder(r), name(n), category(c) {
+        if (recorder != nullptr)
+            recorder->begin(name, category);
+    }
+    
+    ~ScopedTrace() {
+        if (recorder != nullptr)
+            recorder->end(name, category);
+    }
+    
+private:
+    
+    TraceRecorder *recorder;
+    const char *name;
+    const char *category;
+    
+    JUCE_DECLARE_NON_COPYABLE (ScopedTrace)
+};
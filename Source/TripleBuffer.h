@@ -0,0 +1,74 @@
+/*
+ Lock-free triple buffer
+ 
+ Authors:
+ Luca Bondi (luca.bondi@polimi.it)
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+/** Publish values from a producer thread to a consumer thread without locks or allocations
+ 
+ Three instances of T are allocated once. The producer fills the back buffer and publishes it,
+ the consumer swaps in the latest published buffer and reads it. Neither side ever waits for the other,
+ the consumer simply skips the values published between two reads.
+ There must be a single producer thread and a single consumer thread.
+ */
+template<typename T>
+class TripleBuffer {
+    
+public:
+    
+    TripleBuffer() = default;
+    
+    /** Apply a function to the three buffers, e.g. to preallocate them. Not thread safe. */
+    template<typename Fn>
+    void forEach(Fn &&fn) {
+        for (auto &b : buffers)
+            fn(b);
+    }
+    
+    /** Buffer to be filled by the producer */
+    T &getWriteBuffer() {
+        return buffers[back];
+    }
+    
+    /** Make the write buffer the latest value. Producer only. */
+    void publish() {
+        back = middle.exchange(back | freshFlag) & indexMask;
+    }
+    
+    /** Swap in the latest published value, if any. Consumer only.
+     
+     @return: true if a new value was published since the last call
+     */
+    bool update() {
+        if ((middle.load() & freshFlag) == 0)
+            return false;
+        front = middle.exchange(front) & indexMask;
+        return true;
+    }
+    
+    /** Latest value swapped in by update. Consumer only. */
+    const T &getReadBuffer() const {
+        return buffers[front];
+    }
+    
+private:
+    
+    static constexpr int indexMask = 3;
+    static constexpr int freshFlag = 4;
+    
+    T buffers[3];
+    
+    /** Owned by the producer */
+    int back = 0;
+    /** Shared, with the fresh flag set when published and not yet read */
+    std::atomic<int> middle{1};
+    /** Owned by the consumer */
+    int front = 2;
+    
+    JUCE_DECLARE_NON_COPYABLE (TripleBuffer)
+};
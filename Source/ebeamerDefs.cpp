@@ -7,17 +7,86 @@
 
 #include "ebeamerDefs.h"
 
-bool isLinearArray(MicConfig m){
+ArrayLayout getArrayLayout(MicConfig m){
     switch(m){
         case ULA_1ESTICK:
+            return {1, 1};
         case ULA_2ESTICK:
+            return {2, 1};
         case ULA_3ESTICK:
+            return {3, 1};
         case ULA_4ESTICK:
-            return true;
+            return {4, 1};
         case URA_2ESTICK:
+            return {1, 2};
         case URA_3ESTICK:
+            return {1, 3};
         case URA_4ESTICK:
+            return {1, 4};
         case URA_2x2ESTICK:
+            return {2, 2};
+    }
+    return {1, 1};
+}
+
+bool isValidArrayLayout(const ArrayLayout &layout){
+    return layout.numSticksPerRow >= 1 && layout.numRows >= 1
+           && layout.numSticksPerRow * layout.numRows <= MAX_NUM_ESTICKS;
+}
+
+bool parseArrayLayout(const String &text, ArrayLayout &layout){
+    const String trimmed = text.trim().toLowerCase();
+    if (trimmed.containsChar('x')) {
+        const String perRow = trimmed.upToFirstOccurrenceOf("x", false, false).trim();
+        const String rows = trimmed.fromFirstOccurrenceOf("x", false, false).trim();
+        if (!perRow.containsOnly("0123456789") || !rows.containsOnly("0123456789")
+            || perRow.isEmpty() || rows.isEmpty()) {
             return false;
+        }
+        layout = {perRow.getIntValue(), rows.getIntValue()};
+        return isValidArrayLayout(layout);
+    }
+    if (trimmed.isEmpty() || !trimmed.containsOnly("0123456789")) {
+        return false;
+    }
+    const int configIdx = trimmed.getIntValue();
+    if (configIdx >= micConfigLabels.size()) {
+        return false;
+    }
+    layout = getArrayLayout(static_cast<MicConfig>(configIdx));
+    return true;
+}
+
+String getArrayLayoutLabel(const ArrayLayout &layout){
+    if (layout.numRows == 1) {
+        return layout.numSticksPerRow == 1 ? "Single" : "Horiz " + String(layout.numSticksPerRow);
     }
-};
+    if (layout.numSticksPerRow == 1) {
+        return "Stack " + String(layout.numRows);
+    }
+    return "Stack " + String(layout.numSticksPerRow) + "x" + String(layout.numRows);
+}
+
+bool isLinearArray(const ArrayLayout &layout){
+    return layout.numRows == 1;
+}
+
+bool isLinearArray(MicConfig m){
+    return isLinearArray(getArrayLayout(m));
+}
+
+int getNumMics(const ArrayLayout &layout){
+    return ESTICK_NUM_MICS * layout.numSticksPerRow * layout.numRows;
+}
+
+int getNumMics(MicConfig m){
+    return getNumMics(getArrayLayout(m));
+}
+
+int getNumRows(const ArrayLayout &layout){
+    return layout.numRows;
+}
+
+int getNumRows(MicConfig m){
+    return getNumRows(getArrayLayout(m));
+}
@@ -8,8 +8,9 @@
 #pragma once
 
 #define NUM_BEAMS 2
-#define NUM_DOAX 25
-#define NUM_DOAY 9
+
+#define ESTICK_NUM_MICS 16
+#define MAX_NUM_ESTICKS 8
 
 #define GUI_WIDTH 540
 #define GUI_HEIGHT 830
@@ -48,7 +49,7 @@
 
 #define FOOTER_MARGIN 10
 #define FOOTER_HEIGHT 20
-#define CPULOAD_WIDTH 140
+#define CPULOAD_WIDTH 200
 #define CPULOAD_UPDATE_FREQ 10 //Hz
 
 #define FRONT_TOGGLE_LABEL_WIDTH 40
@@ -58,12 +59,15 @@
 #define CONFIG_COMBO_WIDTH 105
 
 #define INPUT_METER_UPDATE_FREQ 10 //Hz
+#define INPUT_METER_PEAK_HOLD 1.5 //s
 #define BEAM_METER_UPDATE_FREQ 10 //Hz
 #define ENERGY_UPDATE_FREQ 10 //Hz
 
 #include "../JuceLibraryCode/JuceHeader.h"
 
-/** Available eSticks configurations type */
+/** Available eSticks configurations type. The index is the "config" choice parameter, never reorder or extend it.
+ Other layouts are described at runtime by an ArrayLayout.
+ */
 typedef enum {
     ULA_1ESTICK,
     ULA_2ESTICK,
@@ -87,4 +91,43 @@ const StringArray micConfigLabels({
                                           "Stack 2x2",
                                   });
 
+/** Physical layout of a configuration. eSticks are horizontal lines of ESTICK_NUM_MICS microphones,
+ placed side by side in each row, the rows stacked vertically.
+ */
+typedef struct {
+    /** Number of eSticks side by side in each row */
+    int numSticksPerRow;
+    /** Number of rows of eSticks */
+    int numRows;
+} ArrayLayout;
+
+/** Layout of a configuration */
+ArrayLayout getArrayLayout(MicConfig m);
+
+/** True if the layout has at least one eStick and at most MAX_NUM_ESTICKS */
+bool isValidArrayLayout(const ArrayLayout &layout);
+
+/** Parse a layout, either a MicConfig index or eSticks per row times rows, e.g. "4x2"
+ 
+ @return: false if the text is neither or the layout is not valid
+ */
+bool parseArrayLayout(const String &text, ArrayLayout &layout);
+
+/** Label of a layout, the same as micConfigLabels for the MicConfig ones, e.g. "Horiz 6" or "Stack 4x2" */
+String getArrayLayoutLabel(const ArrayLayout &layout);
+
+bool isLinearArray(const ArrayLayout &layout);
+
 bool isLinearArray(MicConfig m);
+
+/** Total number of microphones of a layout */
+int getNumMics(const ArrayLayout &layout);
+
+/** Total number of microphones of a configuration */
+int getNumMics(MicConfig m);
+
+/** Number of rows of microphones of a layout */
+int getNumRows(const ArrayLayout &layout);
+
+/** Number of rows of microphones of a configuration */
+int getNumRows(MicConfig m);